@@ -0,0 +1,53 @@
+/*
+ * Per-arc measures accumulated while libtourtre builds the contour tree. One instance hangs
+ * off each ctArc's data pointer; vertices are added as the sweep assigns them to the arc
+ * and arcs absorbed during simplification are merged into their survivor.
+ */
+
+#ifndef ARC_INTEGRALS_H
+#define ARC_INTEGRALS_H
+
+#include <cstddef>
+
+struct ArcIntegrals
+{
+    size_t num_cells;
+    double volume;              // cm^3
+    double mass;                // dens-weighted, g
+    double px, py, pz;          // momentum, g cm/s
+    float gpot_min, gpot_max;
+    size_t hi, lo;              // the arc's upper and lower vertices, row-major cell ids
+
+    ArcIntegrals() :
+        num_cells(0), volume(0.0), mass(0.0), px(0.0), py(0.0), pz(0.0),
+        gpot_min(0.0), gpot_max(0.0), hi(0), lo(0) {}
+
+    void addCell(const double cell_vol, const float dens,
+                 const float velx, const float vely, const float velz, const float gpot)
+    {
+        const double cell_mass = cell_vol * dens;
+        if (num_cells == 0 || gpot < gpot_min) gpot_min = gpot;
+        if (num_cells == 0 || gpot > gpot_max) gpot_max = gpot;
+        num_cells++;
+        volume += cell_vol;
+        mass += cell_mass;
+        px += cell_mass * velx;
+        py += cell_mass * vely;
+        pz += cell_mass * velz;
+    }
+
+    void merge(const ArcIntegrals & other)
+    {
+        if (other.num_cells == 0) return;
+        if (num_cells == 0 || other.gpot_min < gpot_min) gpot_min = other.gpot_min;
+        if (num_cells == 0 || other.gpot_max > gpot_max) gpot_max = other.gpot_max;
+        num_cells += other.num_cells;
+        volume += other.volume;
+        mass += other.mass;
+        px += other.px;
+        py += other.py;
+        pz += other.pz;
+    }
+};
+
+#endif
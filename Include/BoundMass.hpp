@@ -0,0 +1,202 @@
+/*
+ * Bound mass and energetics of a set of cells (a core region, a box around a sink, ...).
+ *
+ * computeBoundMass() makes two parallel passes: mass, momentum and the reference (max) gpot
+ * of the region, then every cell's Ekin + Etherm + Egrav relative to the region's CoM
+ * velocity and reference gpot (a cell can't be classified before those are known). Both are
+ * derived-field reductions (DerivedField.hpp), so every result is the same for 1 or 64
+ * threads and the rounding error doesn't grow with the core size.
+ */
+
+#ifndef BOUND_MASS_H
+#define BOUND_MASS_H
+
+#include <vector>
+#include <cstddef>
+#include <math.h>
+
+#include "Global.h"
+#include "FieldStore.hpp"
+#include "DerivedField.hpp"
+
+struct BoundMass
+{
+    size_t num_cells;
+    double region_mass;
+    double com_vel[3];
+    double reference_gpot;
+    double bound_mass;
+    size_t num_bound;
+    double Ekin, Etherm, Egrav;     // summed over the region
+
+    double virialRatio() const { return 2.0 * (Ekin + Etherm) / fabs(Egrav); }
+};
+
+/*
+ * The fields of one checkpoint as derived-field expressions (FIELD_GPOT .. FIELD_VELZ must be
+ * resident), and the energies of every cell relative to a region's CoM and reference gpot,
+ * as expressions too. energies() evaluates those at a single cell.
+ */
+struct CellEnergetics
+{
+    typedef Binary<Constant, FieldRef, MulOp> Mass;
+    typedef Unary<Binary<FieldRef, Constant, SubOp>, SqrOp> RelativeSqr;
+    typedef Binary<Binary<Constant, Mass, MulOp>,
+                   Binary<Binary<RelativeSqr, RelativeSqr, AddOp>, RelativeSqr, AddOp>, MulOp> Kinetic;
+    typedef Binary<Mass, FieldRef, MulOp> Thermal;
+    typedef Binary<Mass, Binary<FieldRef, Constant, SubOp>, MulOp> Gravitational;
+    typedef Binary<Binary<Kinetic, Thermal, AddOp>, Gravitational, AddOp> Total;
+
+    const FieldRef gpot, dens, eint, velx, vely, velz;
+    const double cell_vol;
+    const Mass mass;
+
+    CellEnergetics(FieldStore & fields, const double vol) :
+        gpot(fields.ptr(FIELD_GPOT)), dens(fields.ptr(FIELD_DENS)), eint(fields.ptr(FIELD_EINT)),
+        velx(fields.ptr(FIELD_VELX)), vely(fields.ptr(FIELD_VELY)), velz(fields.ptr(FIELD_VELZ)),
+        cell_vol(vol), mass(cell_vol * dens) {}
+
+    Kinetic kinetic(const BoundMass & region) const
+    {
+        return 0.5 * mass * (sqr(velx - region.com_vel[0]) + sqr(vely - region.com_vel[1])
+                             + sqr(velz - region.com_vel[2]));
+    }
+
+    Thermal thermal() const { return mass * eint; }
+
+    Gravitational gravitational(const BoundMass & region) const
+    {
+        return mass * (gpot - region.reference_gpot);
+    }
+
+    Total total(const BoundMass & region) const
+    {
+        return kinetic(region) + thermal() + gravitational(region);
+    }
+
+    void energies(const size_t i, const BoundMass & region, double & Ekin, double & Etherm,
+                  double & Egrav) const
+    {
+        Ekin = kinetic(region)(i);
+        Etherm = thermal()(i);
+        Egrav = gravitational(region)(i);
+    }
+};
+
+/*
+ * Fills result for the cells (AllCells, CellList or a VolumeView), and cell_energies with the
+ * total energy of each, in the order of the set
+ */
+template <typename Cells>
+void computeBoundMass(const CellEnergetics & e, const Cells & cells,
+                      std::vector<double> & cell_energies, BoundMass & result)
+{
+    // pass 1: mass, momentum and max gpot
+    double sums[5];
+    sumOver(cells, sums, e.mass, e.mass * e.velx, e.mass * e.vely, e.mass * e.velz);
+    result.num_cells = cellCount(cells);
+    result.region_mass = sums[0];
+    for (int d = 0; d < 3; ++d) result.com_vel[d] = sums[1 + d] / result.region_mass;
+    result.reference_gpot = maxOver(cells, e.gpot);
+
+    // pass 2: energies of every cell, and the bound ones summed
+    const CellEnergetics::Total Etotal = e.total(result);
+    cell_energies.resize(result.num_cells);
+    evaluateAndSum(cells, Etotal, cell_energies.empty() ? NULL : &cell_energies[0], sums,
+                   e.mass * (Etotal < 0.0), Etotal < 0.0,
+                   e.kinetic(result), e.thermal(), e.gravitational(result));
+    result.bound_mass = sums[0];
+    result.num_bound = sums[1];
+    result.Ekin = sums[2];
+    result.Etherm = sums[3];
+    result.Egrav = sums[4];
+}
+
+/*
+ * Iterative unbinding: classify against the CoM of the whole region (computeBoundMass), drop
+ * the unbound cells, move the CoM to that of the cells left and classify those again, until
+ * no cell is dropped or max_iterations rounds have been made. Dropped cells stay dropped, and
+ * the reference gpot stays that of the whole region (the potential at its boundary).
+ *
+ * The mass and momentum sums are updated by subtracting only the cells dropped in a round, so
+ * a new CoM costs O(dropped cells); the cells left are re-classified in parallel, as every
+ * one of their Ekin moves with the CoM. On return result describes the cells left bound
+ * (energy totals over those), cell_energies holds each cell's energy when it was last
+ * classified, and the number of rounds made is returned.
+ */
+template <typename Cells>
+unsigned int unbindIteratively(const CellEnergetics & e, const Cells & cells,
+                               const unsigned int max_iterations,
+                               std::vector<double> & cell_energies, BoundMass & result)
+{
+    computeBoundMass(e, cells, cell_energies, result);
+    const size_t n = cellCount(cells);
+
+    CompensatedSum mass, mom[3];
+    mass.add(result.region_mass);
+    for (int d = 0; d < 3; ++d) mom[d].add(result.com_vel[d] * result.region_mass);
+
+    std::vector<size_t> alive, dropped;     // positions in the cell set
+    alive.reserve(result.num_bound);
+    for (size_t j = 0; j < n; ++j)
+    {
+        if (cell_energies[j] < 0.0) alive.push_back(j);
+        else dropped.push_back(j);
+    }
+
+    unsigned int rounds = 1;
+    while (!dropped.empty() && !alive.empty() && rounds < max_iterations)
+    {
+        for (size_t k = 0; k < dropped.size(); ++k)
+        {
+            const size_t i = cellAt(cells, dropped[k]);
+            const double cell_mass = e.mass(i);
+            mass.add(-cell_mass);
+            mom[0].add(-cell_mass * e.velx(i));
+            mom[1].add(-cell_mass * e.vely(i));
+            mom[2].add(-cell_mass * e.velz(i));
+        }
+        for (int d = 0; d < 3; ++d) result.com_vel[d] = mom[d].value() / mass.value();
+        ++rounds;
+
+        const long num_alive = alive.size();
+        #pragma omp parallel for schedule(static)
+        for (long k = 0; k < num_alive; ++k)
+        {
+            const size_t j = alive[k];
+            double Ekin, Etherm, Egrav;
+            e.energies(cellAt(cells, j), result, Ekin, Etherm, Egrav);
+            cell_energies[j] = Ekin + Etherm + Egrav;
+        }
+
+        dropped.clear();
+        size_t kept = 0;
+        for (long k = 0; k < num_alive; ++k)
+        {
+            if (cell_energies[alive[k]] < 0.0) alive[kept++] = alive[k];
+            else dropped.push_back(alive[k]);
+        }
+        alive.resize(kept);
+    }
+
+    // totals over the cells left bound, relative to the last CoM
+    CompensatedSum bound_mass, Ekin_sum, Etherm_sum, Egrav_sum;
+    for (size_t k = 0; k < alive.size(); ++k)
+    {
+        const size_t i = cellAt(cells, alive[k]);
+        double Ekin, Etherm, Egrav;
+        e.energies(i, result, Ekin, Etherm, Egrav);
+        bound_mass.add(e.mass(i));
+        Ekin_sum.add(Ekin);
+        Etherm_sum.add(Etherm);
+        Egrav_sum.add(Egrav);
+    }
+    result.bound_mass = bound_mass.value();
+    result.num_bound = alive.size();
+    result.Ekin = Ekin_sum.value();
+    result.Etherm = Etherm_sum.value();
+    result.Egrav = Egrav_sum.value();
+    return rounds;
+}
+
+#endif
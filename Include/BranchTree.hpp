@@ -0,0 +1,95 @@
+/*
+ * Flat (pointer-free) form of a libtourtre branch decomposition, with a compact binary
+ * file format that can be memory-mapped and used without rebuilding the contour tree.
+ *
+ * Branches are numbered breadth-first from the root (0), so the children of branch i are
+ * the contiguous range [first_child[i], first_child[i] + num_children[i]). A forest (the
+ * dens dendrogram, see Dendrogram.hpp) has all its roots first, each with parent NO_BRANCH.
+ *
+ * File layout (native endianness):
+ *      BranchFileHeader
+ *      uint64 extremum[n], uint64 saddle[n], double extremum_value[n], double saddle_value[n],
+ *      uint64 arc_size[n], uint32 parent[n], uint32 first_child[n], uint32 num_children[n]
+ */
+
+#ifndef BRANCH_TREE_H
+#define BRANCH_TREE_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <stdint.h>
+
+#include "Global.h"
+#include "Data.h"
+
+struct ctBranch;    // forward dec. (tourtre.h)
+
+#define NO_BRANCH uint32_t(0xffffffff)  // no branch: branch ids are 32 bit in the file
+
+struct BranchFileHeader
+{
+    char magic[8];          // "CTBRANCH"
+    uint32_t version;
+    uint32_t num_nodes;
+};
+
+struct FlatBranchTree
+{
+    std::vector< uint64_t > extremum, saddle;   // mesh vertices
+    std::vector< double > extremum_value, saddle_value;
+    std::vector< uint64_t > arc_size;           // vertices mapped to each branch
+    std::vector< uint32_t > parent;             // NO_BRANCH for the root
+    std::vector< uint32_t > first_child, num_children;
+
+    uint numNodes() const { return extremum.size(); }
+};
+
+/*
+ * Flattens the tree below root without recursion. branch_map (from ct_branchMap, may be
+ * NULL) gives the arc sizes. The data field of every ctBranch is borrowed and restored.
+ */
+template <typename T>
+void flattenBranchTree(ctBranch * root, ctBranch ** branch_map, Data<T> & data, FlatBranchTree & flat);
+
+bool writeBranchTree(const std::string filename, const FlatBranchTree & flat);
+bool readBranchTree(const std::string filename, FlatBranchTree & flat);
+
+/*
+ * Streaming s-expression export "(extremum saddle (child ...) ...)", without recursion
+ */
+void writeBranchText(std::ostream & out, ctBranch * root);
+void writeBranchText(std::ostream & out, const FlatBranchTree & flat);
+
+
+/*
+ * Read-only view of a branch tree file mapped straight into memory
+ */
+class MappedBranchTree
+{
+    private:
+        void * mapping;
+        size_t mapping_size;
+        uint32_t num_nodes;
+
+        MappedBranchTree(const MappedBranchTree &);     // not copyable
+        MappedBranchTree & operator=(const MappedBranchTree &);
+
+    public:
+        const uint64_t * extremum;
+        const uint64_t * saddle;
+        const double * extremum_value;
+        const double * saddle_value;
+        const uint64_t * arc_size;
+        const uint32_t * parent;
+        const uint32_t * first_child;
+        const uint32_t * num_children;
+
+        MappedBranchTree(const std::string filename);   // ctor
+        ~MappedBranchTree();
+
+        bool isOpen() const { return mapping != 0; }
+        uint numNodes() const { return num_nodes; }
+};
+
+#endif
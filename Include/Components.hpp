@@ -0,0 +1,36 @@
+/*
+ * Connected components of a thresholded field ("every region with dens above X"), a quick
+ * alternative to the contour tree, under 6, 18 or 26 connectivity (see Stencil.hpp).
+ *
+ * The grid is cut into z slabs, one block per task. Each block runs a union-find over its own
+ * cells in raster order, linking every cell to its lower-index neighbours inside the block;
+ * the blocks touch disjoint parts of the parent array, so they run in parallel without locks.
+ * The planes where blocks meet are merged afterwards, keeping count of the sets left in each
+ * block, so the roots can be numbered block by block in parallel and every other cell takes
+ * its root's number in one more pass. A root is always the lowest index of its component, so
+ * the labels come out in raster order of each component's first cell, the same for any number
+ * of threads.
+ */
+
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <vector>
+
+#include "Global.h"
+#include "Stencil.hpp"
+
+struct Components
+{
+    std::vector< VertexId > label;      // per row-major cell, NOTHING outside the threshold
+    std::vector< VertexId > size;       // cells per component
+    std::vector< VertexId > first;      // lowest (row-major) cell of each component
+
+    VertexId count() const { return size.size(); }
+};
+
+// cells with value > threshold (above) or < threshold (!above); connectivity 6, 18 or 26
+void labelComponents(const float * values, const uint size[3], const float threshold,
+                     const bool above, const Connectivity connectivity, Components & out);
+
+#endif
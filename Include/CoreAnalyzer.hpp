@@ -5,8 +5,19 @@
 #include <vector>
 #include <string>
 
+#include "Global.h"
+#include "Layout.hpp"
+#include "Stencil.hpp"
+#include "FieldStore.hpp"
+#include "JoinTree.hpp"
+#include "ArcIntegrals.hpp"
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
 class SinkRecord;   // forward dec.
 class Sink;
+template <typename T, typename L> struct Data;
 
 class CoreAnalyzer
 {
@@ -16,10 +27,8 @@ class CoreAnalyzer
         std::vector< Sink > sinks;
         int sink_id;    // the sink whose core we're interested in
 
-        std::vector< std::string > var_names;
-        std::map< std::string,  std::vector<float> > data_map;  // maps var names to data
-        std::map< std::string,  std::vector<float> > bounds_map;  // bounds should all be equal
-        std::vector< float > minmax_xyz;    // set by calling check_bounds_map()
+        FieldStore fields;  // gpot, dens_pp, ... with their bounds, which should all be equal
+        std::vector< float > minmax_xyz;    // set by calling check_bounds()
 
         int pixel_size;
         double cell_size;    // in cm
@@ -30,18 +39,31 @@ class CoreAnalyzer
         float core_volume;
         double core_region_mass;
         double bound_core_region_mass;
-        std::vector<double> core_cell_energies;
+        std::vector<double> core_cell_energies;    // per core_indices cell, via calculateBoundMass()
+        std::vector<ArcIntegrals> arc_integrals;    // every arc, set via findCoreRegion()
 
         bool sinks_mapped;
+        int key_bits;   // 0: sweep the gpot values themselves, else 16 or 32 bit sort keys
+        LayoutType layout;  // of the gpot copy findCoreRegion() sweeps
+        Connectivity connectivity;  // neighbours handed to libtourtre
+        unsigned int unbind_iterations; // 1: classify once against the CoM of the whole core
+
+        std::vector<VertexId> core_indices;  // set via ctArcmap() 
+        VertexId sink_cell_index;
 
-        std::vector<unsigned int> core_indices;  // set via ctArcmap() 
-        unsigned int sink_cell_index;
+        JoinTree gpot_join_tree;    // set via findJoinTreeOutOfCore()
 
         std::vector<float> index_to_position(const unsigned int index);
-        void setVariableNames();
-        void check_bounds_map();
+        unsigned int position_to_index(const std::vector<float> & position);
+        void addSinkGravity(float * gpot, const unsigned int first_index, const unsigned int count);
+        void readGridGeometry(unsigned int size[3]);
+        void set_cell_size();
+        void check_bounds();
         void check_data_minmax();
 
+        template <typename T, typename L>
+        void sweepCoreRegion(Data<T, L> & data, std::vector<VertexId> & totalOrder);  // releases totalOrder
+
         CoreAnalyzer();   // private default ctor --> Don't use
 
     public:
@@ -50,14 +72,57 @@ class CoreAnalyzer
                      const SinkRecord & sink_rec,
                      const int id);  // ctor
 
-        void loadAllData ();
+        void loadAllData ();    // every field, up front
+        void openData (const size_t field_budget);  // fields loaded lazily, 0: no memory limit
+        void loadField (const FieldId f, float * values, float * bounds);  // the FieldStore loader
 
-        void mapSinkGravity ();
+        void mapSinkGravity ();    // gpot includes the sink potentials from now on, as it is loaded
 
         void findCoreRegion (); // using libtourtre
+        void setKeyBits (const int bits);   // see QuantizedKeys.hpp
+        void setLayout (const std::string name);    // "row", "brick" or "morton", see Layout.hpp
+        void setConnectivity (const std::string name);  // "tet", "6", "18" or "26", see Stencil.hpp
+        void benchmarkLayouts ();   // neighbour-gather throughput of gpot in each layout
+        void writeArcIntegrals (const std::string filename) const;
+        // mass and bound mass of the core region against the gpot level bounding it
+        void writeThresholdProfile (const std::string filename, const unsigned int num_levels);
         void altFindCoreRegion(); // my hand written algorithm
 
+        // every gpot minimum with persistence >= threshold (erg/g) is a core, sink or not;
+        // regions and bound masses for all of them in one go, one row each in the catalogue;
+        // radius > 0: only the minima in the box of that half-width (cells) around the sink
+        void findAllCores (const float persistence_threshold, const std::string catalogue_file,
+                           const unsigned int radius = 0);
+
+        // connected regions of field ("dens", "gpot", ...) above (or below) threshold, one row
+        // each in the catalogue; 6, 18 or 26 connectivity, see setConnectivity()
+        void findComponents (const std::string field, const float threshold, const bool above,
+                             const std::string catalogue_file);
+
+        // dens dendrogram (clump hierarchy) in the binary branch tree format, see Dendrogram.hpp
+        void writeDendrogram (const float min_value, const float min_delta, const size_t min_cells,
+                              const std::string filename);
+
+        // log-binned radial profiles around every sink, radii in cells, see RadialProfile.hpp
+        void writeSinkProfiles (const double r_min, const double r_max, const unsigned int num_bins,
+                                const std::string filename);
+
+        // streams gpot (+ sink gravity) from file in slabs, for grids that don't fit in memory
+        void findJoinTreeOutOfCore (const size_t memory_budget);
+        void loadGravitySlab (const unsigned int z_begin, const unsigned int num_z, float * slab);
+
+#ifdef USE_MPI
+        // each rank of comm sweeps its own slab, rank 0 ends up with the whole tree
+        void findJoinTreeMPI (MPI_Comm comm, const bool verify);
+        void loadGravitySlab (const unsigned int z_begin, const unsigned int num_z, float * slab,
+                              MPI_Comm comm);
+#endif
+
         float calculateBoundMass ();
+        void setUnbindIterations (const unsigned int max_iterations);  // see unbindIteratively()
+        float calculateBoundMassInBox (const unsigned int radius);   // cube around the sink cell
+        // x, y and z projections of the box around every sink, core region overlaid, to HDF5
+        void writeSinkProjections (const unsigned int radius, const std::string filename);
 
         float getRegionVolume ();
 
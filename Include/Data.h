@@ -6,40 +6,48 @@
 #include <cmath>
 
 #include "Global.h"
+#include "Layout.hpp"
 
+/*
+ * Scalar field on a regular grid, templated on the value type so a float field can be
+ * used (or wrapped in place) without widening every value to double, and on the memory
+ * layout (see Layout.hpp). Vertex ids are storage positions in that layout.
+ */
+template <typename T, typename L = RowMajor>
 struct Data 
 {
-	DataType * data; //the data array
+	T * data; //the data array
 	uint size[3]; //dimensions
-	uint totalSize; //product of the above 3 integers
+	VertexId totalSize; //product of the above 3 integers
+	bool owner; //false if data points into someone else's buffer (see wrap())
 
-	DataType maxValue, minValue; //max and min values occuring in the data
+	T maxValue, minValue; //max and min values occuring in the data
 		
-	std::vector< DataType > saddles; //we will fill this up with all of the saddles that exist in the data
+	std::vector< T > saddles; //we will fill this up with all of the saddles that exist in the data
 	
-	Data() : data(0),totalSize(0) 
+	Data() : data(0),totalSize(0),owner(false) 
 	{
 		size[0] = size[1] = size[2] = 0;
 	}
 	
 	~Data() 
 	{
-		if (data) delete[] data;
+		release();
 	}
 
 	//1 dimensional referencing
-	DataType & operator[](uint i) 
+	T & operator[](VertexId i) 
 	{ 
 		if (i < totalSize) return data[i]; 
 		else return saddles[i - totalSize];
 	}
 	
-	uint convertIndex( uint i, uint j, uint k ) 
+	VertexId convertIndex( uint i, uint j, uint k ) 
 	{
-		return (k * size[1] + j) * size[0] + i; 
+		return L::index(i, j, k, size); 
 	}
 	 
-	void convertIndex( uint id, uint & x, uint & y, uint & z ) 
+	void convertIndex( VertexId id, uint & x, uint & y, uint & z ) 
 	{	
 		if (id >= totalSize) {
 			std::cout << "Error: trying to convert the index of a saddle into xyz" << std::endl;
@@ -47,17 +55,38 @@ struct Data
 			return;
 		}
 		
-		int size01 = size[0] * size[1];
-		
-		z = id / size01;
-		y = (id - z*size01) / size[0];
-		x = id - z*size01 - y*size[0];
+		L::coords(id, size, x, y, z);
+	}
+
+	//index of vertex id in the row-major arrays the other fields are kept in
+	VertexId toRowMajor( VertexId id ) 
+	{
+		return L::toRowMajor(id, size);
+	}
+
+	VertexId fromRowMajor( VertexId r ) 
+	{
+		uint x,y,z;
+		RowMajor::coords(r, size, x, y, z);
+		return L::index(x, y, z, size);
 	}
 	
-	bool greater(uint a, uint b);
-	bool less(uint a, uint b);
-	void loadFromVector(const std::vector<float>& gpot, const std::vector<float>::size_type totalSize); 
+	bool greater(VertexId a, VertexId b);
+	bool less(VertexId a, VertexId b);
+	//gpot is row-major, dims[0] x dims[1] x dims[2] values
+	void loadFromVector(const std::vector<float>& gpot, const uint dims[3]); 
+	//values are row-major, and reordered into L
+	void loadFromArray(const float * values, const uint nx, const uint ny, const uint nz);
+	//no copy: values (already in layout L) must outlive this Data, and are never written through it
+	void wrap(T * values, const uint nx, const uint ny, const uint nz);
+
+	private:
+	void release();
+	void findMinMax();
+	void scatter(const float * values);
 
+	Data(const Data &);	//not copyable, may own its buffer
+	Data & operator=(const Data &);
 };
 
 
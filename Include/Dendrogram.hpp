@@ -0,0 +1,48 @@
+/*
+ * Density dendrogram: the split tree of dens maxima (clumps inside clumps), pruned the way
+ * observers' dendrogram codes prune it, so the catalogues can be compared directly.
+ *
+ * Only cells above min_value take part. They are picked out and sorted by Data::greater() in
+ * parallel, then swept from the densest down, each cell joining the structures of the
+ * neighbours already swept (Mesh stencils, any Connectivity):
+ *
+ *  - no such neighbour: the cell is a new leaf (a local maximum)
+ *  - one structure: the cell joins it
+ *  - two or more: a leaf is significant if its peak is at least min_delta above the cell and
+ *    it has at least min_cells cells; branches always are. Two or more significant ones become
+ *    the children of a new branch starting at the cell, otherwise all of them are merged into
+ *    the significant one (or the one with the highest peak). Insignificant leaves are merged
+ *    into whatever they meet, so they never show up in the tree.
+ *
+ * Whole trees (trunks) whose only structure is an insignificant leaf are dropped at the end.
+ * The result is a FlatBranchTree (see BranchTree.hpp), so it goes through writeBranchTree(),
+ * MappedBranchTree and writeBranchText() like the contour tree's branch decomposition. There
+ * can be several trunks: they come first, in descending peak order, with parent NO_BRANCH.
+ *
+ *      extremum    the structure's peak (the densest cell of it and its children)
+ *      saddle      the cell where it meets its parent, for a trunk its lowest cell
+ *      arc_size    cells of the structure itself, merged leaves included, children not
+ */
+
+#ifndef DENDROGRAM_H
+#define DENDROGRAM_H
+
+#include <cstddef>
+
+#include "Global.h"
+#include "Mesh.h"
+#include "Stencil.hpp"
+#include "BranchTree.hpp"
+
+struct DendrogramParams
+{
+    float min_value;    // cells at or below this are left out
+    float min_delta;    // a leaf's peak must rise this far above where it merges
+    size_t min_cells;   // ... and it must have this many cells
+};
+
+// mesh over a row-major Data<float> (dens); tree gets one node per structure kept
+void buildDendrogram(Mesh<float> & mesh, const Connectivity connectivity,
+                     const DendrogramParams & params, FlatBranchTree & tree);
+
+#endif
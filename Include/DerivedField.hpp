@@ -0,0 +1,246 @@
+/*
+ * Per-cell quantities derived from FieldStore fields, as expression templates.
+ *
+ * An expression like  0.5 * mass * (sqr(velx - vx0) + ...)  builds a small tree of nodes at
+ * compile time; nothing is evaluated until a reduction (sumOver, maxOver, evaluateAndSum) runs
+ * one loop over a cell set and calls the tree per cell. The compiler inlines the whole tree
+ * into that loop, so no intermediate volume is ever allocated. Comparisons give 1.0 or 0.0, so
+ * a masked sum is just a product:  sumOver(cells, sums, mass * (energy < 0.0)).
+ *
+ * The reductions cut the set into fixed chunks of DERIVED_FIELD_CHUNK cells, whatever the
+ * number of threads; each chunk sums its cells in order, and the chunk sums are combined in
+ * chunk order with a compensated (Neumaier) sum, so every result is the same for 1 or 64
+ * threads and the rounding error doesn't grow with the set.
+ *
+ * Nodes are held by value (they are a pointer or a double each), and evaluate in double.
+ */
+
+#ifndef DERIVED_FIELD_H
+#define DERIVED_FIELD_H
+
+#include <cstddef>
+#include <vector>
+#include <cmath>
+#include <math.h>
+#include <limits>
+
+#include "Global.h"
+#include "VolumeView.hpp"
+
+const size_t DERIVED_FIELD_CHUNK = 4096;
+
+// Neumaier's variant of Kahan summation, exact to about twice double precision
+class CompensatedSum
+{
+    private:
+        double sum;
+        double c;
+
+    public:
+        CompensatedSum() : sum(0.0), c(0.0) {}
+
+        void add(const double x)
+        {
+            const double t = sum + x;
+            if (fabs(sum) >= fabs(x)) c += (sum - t) + x;
+            else c += (x - t) + sum;
+            sum = t;
+        }
+
+        double value() const { return sum + c; }
+};
+
+template <typename E>
+struct Expr
+{
+    const E & self() const { return static_cast<const E &>(*this); }
+};
+
+// a loaded field, indexed like it (row-major)
+struct FieldRef : Expr<FieldRef>
+{
+    const float * values;
+    explicit FieldRef(const float * v) : values(v) {}
+    double operator()(const size_t i) const { return values[i]; }
+};
+
+struct Constant : Expr<Constant>
+{
+    double value;
+    explicit Constant(const double v) : value(v) {}
+    double operator()(const size_t) const { return value; }
+};
+
+template <typename A, typename B, typename Op>
+struct Binary : Expr< Binary<A, B, Op> >
+{
+    A a;
+    B b;
+    Binary(const A & a_, const B & b_) : a(a_), b(b_) {}
+    double operator()(const size_t i) const { return Op::apply(a(i), b(i)); }
+};
+
+template <typename A, typename Op>
+struct Unary : Expr< Unary<A, Op> >
+{
+    A a;
+    explicit Unary(const A & a_) : a(a_) {}
+    double operator()(const size_t i) const { return Op::apply(a(i)); }
+};
+
+struct AddOp  { static double apply(const double a, const double b) { return a + b; } };
+struct SubOp  { static double apply(const double a, const double b) { return a - b; } };
+struct MulOp  { static double apply(const double a, const double b) { return a * b; } };
+struct DivOp  { static double apply(const double a, const double b) { return a / b; } };
+struct LessOp { static double apply(const double a, const double b) { return a < b ? 1.0 : 0.0; } };
+struct MoreOp { static double apply(const double a, const double b) { return a > b ? 1.0 : 0.0; } };
+struct SqrOp  { static double apply(const double a) { return a * a; } };
+struct SqrtOp { static double apply(const double a) { return std::sqrt(a); } };
+
+#define DERIVED_FIELD_BINARY(op, Op)                                                        \
+template <typename A, typename B>                                                           \
+inline Binary<A, B, Op> operator op(const Expr<A> & a, const Expr<B> & b)                  \
+{ return Binary<A, B, Op>(a.self(), b.self()); }                                            \
+template <typename A>                                                                       \
+inline Binary<A, Constant, Op> operator op(const Expr<A> & a, const double b)              \
+{ return Binary<A, Constant, Op>(a.self(), Constant(b)); }                                  \
+template <typename B>                                                                       \
+inline Binary<Constant, B, Op> operator op(const double a, const Expr<B> & b)              \
+{ return Binary<Constant, B, Op>(Constant(a), b.self()); }
+
+DERIVED_FIELD_BINARY(+, AddOp)
+DERIVED_FIELD_BINARY(-, SubOp)
+DERIVED_FIELD_BINARY(*, MulOp)
+DERIVED_FIELD_BINARY(/, DivOp)
+DERIVED_FIELD_BINARY(<, LessOp)
+DERIVED_FIELD_BINARY(>, MoreOp)
+
+#undef DERIVED_FIELD_BINARY
+
+template <typename A>
+inline Unary<A, SqrOp> sqr(const Expr<A> & a) { return Unary<A, SqrOp>(a.self()); }
+
+template <typename A>
+inline Unary<A, SqrtOp> sqrt(const Expr<A> & a) { return Unary<A, SqrtOp>(a.self()); }
+
+/*
+ * Cell sets to reduce over: the whole grid (where the j-th cell is cell j), a list of row-major
+ * ids such as CoreAnalyzer::core_indices, or a box of the grid as a VolumeView. cellCount() is
+ * the size of the set and cellAt() the row-major id of its j-th cell.
+ */
+struct AllCells
+{
+    size_t n;
+    explicit AllCells(const size_t num) : n(num) {}
+};
+
+struct CellList
+{
+    const VertexId * ids;
+    size_t n;
+    explicit CellList(const std::vector< VertexId > & cells) :
+        ids(cells.empty() ? NULL : &cells[0]), n(cells.size()) {}
+};
+
+inline size_t cellCount(const AllCells & cells) { return cells.n; }
+inline size_t cellCount(const CellList & cells) { return cells.n; }
+template <typename T>
+inline size_t cellCount(const VolumeView<T> & box) { return box.size(); }
+
+inline size_t cellAt(const AllCells &, const size_t j) { return j; }
+inline size_t cellAt(const CellList & cells, const size_t j) { return cells.ids[j]; }
+template <typename T>
+inline size_t cellAt(const VolumeView<T> & box, const size_t j) { return box.cellIndex(j); }
+
+// the chunked sum behind the reductions: terms(j, i, t) puts the N terms of cell i, the j-th
+// of the set, in t; their sums over the set go to sums[0 .. N)
+template <size_t N, typename Cells, typename Terms>
+void sumChunks(const Cells & cells, double * sums, const Terms & terms)
+{
+    const size_t n = cellCount(cells);
+    const long num_chunks = (n + DERIVED_FIELD_CHUNK - 1) / DERIVED_FIELD_CHUNK;
+    std::vector<double> part(N * num_chunks);
+
+    #pragma omp parallel for schedule(static)
+    for (long c = 0; c < num_chunks; ++c)
+    {
+        const size_t first = c * DERIVED_FIELD_CHUNK;
+        const size_t last = first + DERIVED_FIELD_CHUNK < n ? first + DERIVED_FIELD_CHUNK : n;
+        double acc[N] = {};
+        for (size_t j = first; j < last; ++j)
+        {
+            double t[N];
+            terms(j, cellAt(cells, j), t);
+            for (size_t k = 0; k < N; ++k) acc[k] += t[k];
+        }
+        for (size_t k = 0; k < N; ++k) part[N * c + k] = acc[k];
+    }
+
+    for (size_t k = 0; k < N; ++k)
+    {
+        CompensatedSum total;
+        for (long c = 0; c < num_chunks; ++c) total.add(part[N * c + k]);
+        sums[k] = total.value();
+    }
+}
+
+// sums every expression over cells in the same loop, into sums[0 .. number of expressions)
+template <typename Cells, typename... E>
+void sumOver(const Cells & cells, double * sums, const Expr<E> &... exprs)
+{
+    const size_t num = sizeof...(E);
+    sumChunks<num>(cells, sums, [&](const size_t, const size_t i, double * t) {
+        const double terms[num] = { exprs.self()(i)... };
+        for (size_t k = 0; k < num; ++k) t[k] = terms[k];
+    });
+}
+
+template <typename Cells, typename E>
+double sumOver(const Cells & cells, const Expr<E> & expr)
+{
+    double sum;
+    sumOver(cells, &sum, expr);
+    return sum;
+}
+
+// as sumOver, and in the same loop stores expr at the j-th cell of the set in out[j]
+template <typename Cells, typename S, typename Out, typename... E>
+void evaluateAndSum(const Cells & cells, const Expr<S> & expr, Out * out, double * sums,
+                    const Expr<E> &... exprs)
+{
+    const size_t num = sizeof...(E);
+    sumChunks<num>(cells, sums, [&](const size_t j, const size_t i, double * t) {
+        out[j] = expr.self()(i);
+        const double terms[num] = { exprs.self()(i)... };
+        for (size_t k = 0; k < num; ++k) t[k] = terms[k];
+    });
+}
+
+template <typename Cells, typename E>
+double maxOver(const Cells & cells, const Expr<E> & expr)
+{
+    const size_t n = cellCount(cells);
+    const long num_chunks = (n + DERIVED_FIELD_CHUNK - 1) / DERIVED_FIELD_CHUNK;
+    std::vector<double> part(num_chunks);
+
+    #pragma omp parallel for schedule(static)
+    for (long c = 0; c < num_chunks; ++c)
+    {
+        const size_t first = c * DERIVED_FIELD_CHUNK;
+        const size_t last = first + DERIVED_FIELD_CHUNK < n ? first + DERIVED_FIELD_CHUNK : n;
+        double biggest = -std::numeric_limits<double>::max();
+        for (size_t j = first; j < last; ++j)
+        {
+            const double v = expr.self()(cellAt(cells, j));
+            if (v > biggest) biggest = v;
+        }
+        part[c] = biggest;
+    }
+
+    double biggest = -std::numeric_limits<double>::max();
+    for (long c = 0; c < num_chunks; ++c)
+        if (part[c] > biggest) biggest = part[c];
+    return biggest;
+}
+
+#endif
@@ -0,0 +1,243 @@
+/*
+ * The grid fields of one checkpoint, indexed by a compile-time FieldId instead of a name.
+ *
+ * Each field is a single 64-byte aligned buffer plus its metadata (the minmax_xyz bounds of
+ * the file it came from, units, min/max and where they are). Kernels take the raw pointer
+ * (or a FieldSpan) once, outside their loops, so a field access costs no more than indexing
+ * a float array.
+ *
+ * With a loader installed, fields are materialised lazily: the first ptr() or require() of a
+ * field reads it through the loader, and under a memory budget the least recently used fields
+ * are evicted to make room (and read again if asked for later). Each analysis stage declares
+ * the fields it needs with require(mask); they are loaded up front and pinned, so no pointer a
+ * stage holds is invalidated by an eviction while it runs. Without a loader, asking for a
+ * field that was never allocated is an error -- it is never created on the fly.
+ */
+
+#ifndef FIELD_STORE_H
+#define FIELD_STORE_H
+
+#include <cstddef>
+#include <cstdlib>  // posix_memalign, free
+#include <iostream>
+#include <assert.h>
+
+#include "Global.h"
+#include "VolumeView.hpp"
+
+enum FieldId { FIELD_GPOT, FIELD_DENS, FIELD_EINT, FIELD_VELX, FIELD_VELY, FIELD_VELZ, NUM_FIELDS };
+
+struct FieldInfo
+{
+    const char * name;      // dataset name in the extracted_* file
+    const char * file;      // extracted_<file>
+    const char * units;
+};
+
+inline const FieldInfo & fieldInfo(const FieldId f)
+{
+    // "_pp" means the sink particle contribution has been added
+    static const FieldInfo info[NUM_FIELDS] = {
+        { "gpot",    "gpot", "erg/g"  },
+        { "dens_pp", "dens", "g/cm^3" },
+        { "eint",    "eint", "erg/g"  },
+        { "velx_pp", "velx", "cm/s"   },
+        { "vely_pp", "vely", "cm/s"   },
+        { "velz_pp", "velz", "cm/s"   }
+    };
+    return info[f];
+}
+
+typedef unsigned int FieldMask;
+inline FieldMask fieldBit(const FieldId f) { return 1u << f; }
+const FieldMask ALL_FIELDS = (1u << NUM_FIELDS) - 1;
+
+// fills values (n of them) and the file's minmax_xyz bounds for field f
+typedef void (*FieldLoader)(const FieldId f, float * values, float * bounds, void * d);
+
+// contiguous view of one field
+struct FieldSpan
+{
+    float * data;
+    size_t size;
+
+    float & operator[](const size_t i) const { return data[i]; }
+    float * begin() const { return data; }
+    float * end() const { return data + size; }
+};
+
+class FieldStore
+{
+    public:
+        static const size_t alignment = 64;     // one cache line, and any SIMD width
+
+        struct Field
+        {
+            float * data;
+            size_t size;
+            float bounds[6];    // minmax_xyz of the file
+            float minValue, maxValue;
+            size_t minIndex, maxIndex;
+            unsigned long last_use;     // for evicting the least recently used
+
+            Field() : data(NULL), size(0), minValue(0), maxValue(0), minIndex(0), maxIndex(0),
+                      last_use(0)
+            {
+                for (int d = 0; d < 6; ++d) bounds[d] = 0.0;
+            }
+        };
+
+        FieldStore() : loader(NULL), loader_data(NULL), field_size(0), budget(0), pinned(0),
+                       clock(0), num_loads(0) { dims[0] = dims[1] = dims[2] = 0; }
+        ~FieldStore() { for (int f = 0; f < NUM_FIELDS; ++f) release(FieldId(f)); }
+
+        // (re)allocates field f with n uninitialised values and returns its buffer
+        float * allocate(const FieldId f, const size_t n)
+        {
+            release(f);
+            void * p = NULL;
+            if (n == 0 || posix_memalign(&p, alignment, n * sizeof(float)) != 0) return NULL;
+            fields[f].data = static_cast<float*>(p);
+            fields[f].size = n;
+            return fields[f].data;
+        }
+
+        void release(const FieldId f)
+        {
+            free(fields[f].data);
+            fields[f].data = NULL;
+            fields[f].size = 0;
+        }
+
+        bool has(const FieldId f) const { return fields[f].data != NULL; }
+
+        // every field is a row-major grid of the given size, read through loader when first needed
+        void setLoader(FieldLoader l, void * d, const uint size[3])
+        {
+            loader = l;
+            loader_data = d;
+            for (int k = 0; k < 3; ++k) dims[k] = size[k];
+            field_size = size_t(size[0]) * size[1] * size[2];
+        }
+
+        // the whole grid of field f, sub-boxes are taken from it with subView() etc.
+        VolumeView<float> view(const FieldId f) { return gridView(ptr(f), dims); }
+
+        // bytes the resident fields may take up, 0 for no limit
+        void setBudget(const size_t bytes) { budget = bytes; }
+
+        // loads the fields in mask that aren't resident, and pins them until the next require()
+        void require(const FieldMask mask)
+        {
+            pinned = mask;
+            for (int f = 0; f < NUM_FIELDS; ++f)
+                if ((mask & fieldBit(FieldId(f))) && !has(FieldId(f))) load(FieldId(f));
+        }
+
+        float * ptr(const FieldId f)
+        {
+            if (!has(f) && loader != NULL) load(f);
+            assert(has(f));
+            fields[f].last_use = ++clock;
+            return fields[f].data;
+        }
+
+        const float * ptr(const FieldId f) const
+        {
+            assert(has(f));
+            return fields[f].data;
+        }
+
+        FieldSpan span(const FieldId f)
+        {
+            FieldSpan s = { ptr(f), fields[f].size };
+            return s;
+        }
+
+        size_t size(const FieldId f) const { return fields[f].size; }
+
+        const Field & meta(const FieldId f) const { return fields[f]; }
+        const float * bounds(const FieldId f) const { return fields[f].bounds; }
+
+        void setBounds(const FieldId f, const float * minmax_xyz)
+        {
+            for (int d = 0; d < 6; ++d) fields[f].bounds[d] = minmax_xyz[d];
+        }
+
+        // min/max of field f and where they are, kept in its metadata
+        void updateMinMax(const FieldId f)
+        {
+            Field & fld = fields[f];
+            if (fld.size == 0) return;
+            fld.minIndex = fld.maxIndex = 0;
+            for (size_t i = 1; i < fld.size; ++i)
+            {
+                if (fld.data[i] < fld.data[fld.minIndex]) fld.minIndex = i;
+                if (fld.data[i] > fld.data[fld.maxIndex]) fld.maxIndex = i;
+            }
+            fld.minValue = fld.data[fld.minIndex];
+            fld.maxValue = fld.data[fld.maxIndex];
+        }
+
+        size_t memoryUsage() const
+        {
+            size_t bytes = 0;
+            for (int f = 0; f < NUM_FIELDS; ++f) bytes += fields[f].size * sizeof(float);
+            return bytes;
+        }
+
+        unsigned int numLoads() const { return num_loads; }    // evicted fields count again
+
+    private:
+        Field fields[NUM_FIELDS];
+
+        FieldLoader loader;
+        void * loader_data;
+        uint dims[3];
+        size_t field_size;
+        size_t budget;
+        FieldMask pinned;
+        unsigned long clock;
+        unsigned int num_loads;
+
+        void load(const FieldId f)
+        {
+            assert(loader != NULL);
+            makeRoom(field_size * sizeof(float));
+            float * values = allocate(f, field_size);
+            if (values == NULL)
+            {
+                std::cerr << "PROBLEM!!! couldn't allocate field " << fieldInfo(f).name << std::endl;
+                return;
+            }
+            loader(f, values, fields[f].bounds, loader_data);
+            updateMinMax(f);
+            fields[f].last_use = ++clock;
+            ++num_loads;
+        }
+
+        // evicts unpinned fields, least recently used first, until bytes more fit the budget
+        void makeRoom(const size_t bytes)
+        {
+            while (budget != 0 && memoryUsage() + bytes > budget)
+            {
+                int victim = -1;
+                for (int f = 0; f < NUM_FIELDS; ++f)
+                {
+                    if (!has(FieldId(f)) || (pinned & fieldBit(FieldId(f)))) continue;
+                    if (victim < 0 || fields[f].last_use < fields[victim].last_use) victim = f;
+                }
+                if (victim < 0)
+                {
+                    std::cerr << "PROBLEM!!! the pinned fields alone exceed the field budget" << std::endl;
+                    return;
+                }
+                release(FieldId(victim));
+            }
+        }
+
+        FieldStore(const FieldStore &);     // owns its buffers, no copies
+        FieldStore & operator=(const FieldStore &);
+};
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef GLOBAL_H
 #define GLOBAL_H
 
+#include <stdint.h>
+
 #ifndef NULL
 #define NULL 0
 #endif
@@ -8,11 +10,18 @@
 #define EVEN_TET_PARITY 0
 #define ODD_TET_PARITY 1
 
-#define NOTHING 0xffffffff
-
 typedef unsigned int uint;
 
-typedef double DataType;     // datatype is referenced with this
+// vertex (cell) ids -- 32 bits cover up to 1024^3 grids, build with -DVERTEX_ID_64 for larger ones
+#ifdef VERTEX_ID_64
+typedef uint64_t VertexId;
+#else
+typedef uint32_t VertexId;
+#endif
+
+#define NOTHING VertexId(-1)    // no vertex (node, label, ...), in any container of VertexId
+
+typedef float DataType;     // default value type for Data<> and Mesh<> (gpot is stored as float)
 #define ABS(x) fabs(x)
 
 //typedef unsigned char DataType;
@@ -22,15 +31,9 @@ typedef double DataType;     // datatype is referenced with this
 #define MAKEINT(x) x
 //define MAKEINT(x) (int(x*0xffff))
 
-//inline bool compareLess( unsigned char a, unsigned char b ) { return a < b; }
-//inline bool compareLess( unsigned short int a, unsigned short int b ) { return a < b; }
-//inline bool compareLess( float a, float b ) { return a < b; }
-inline bool compareLess( double a, double b ) { return a < b; }
-
-//inline bool compareEqual( unsigned char a, unsigned char b ) { return a == b; }
-//inline bool compareEqual( unsigned short int a, unsigned short int b ) { return a == b; }
-//inline bool compareEqual( float a, float b ) { return a == b; }
-inline bool compareEqual( double a, double b ) { return a == b; }
+// comparisons used by Data<T>::less()/greater(), specialize for value types that need it
+template <typename T> inline bool compareLess( T a, T b ) { return a < b; }
+template <typename T> inline bool compareEqual( T a, T b ) { return a == b; }
 
 //#define INTEGRITY_CHECKS
 
@@ -37,6 +37,7 @@ class HDFIO
 		// hdf 5 stuff
         hsize_t HDFSize, HDFDims[4];
 		hid_t   File_id, Dataset_id, Dataspace_id;
+		hid_t   Transfer_id;		//dataset transfer list of every read
 		herr_t  HDF5_status, HDF5_error;
 
         std::string Filename;
@@ -53,6 +54,7 @@ class HDFIO
 		  File_id(0),				//set all to 0
 		  Dataset_id(0),
 		  Dataspace_id(0),
+		  Transfer_id(H5P_DEFAULT),	//independent reads
 		  HDF5_status(0),			//set HDF5 status to 0
 		  HDF5_error(-1),			//set to -1
           Filename()				//create Nullstring
@@ -98,12 +100,50 @@ class HDFIO
 			}
 		};
 
+#ifdef H5_HAVE_PARALLEL
+		/**
+		 * open an HDF5 file read only through the MPI-IO driver (collective over Comm);
+		 * reads from it are collective too, every rank must make the same read calls
+		 * @param Filename HDF5 filename
+		 * @param Comm communicator of all ranks opening the file
+		 *
+		 */
+		void openParallel(const std::string Filename, MPI_Comm Comm)
+		{
+			this->Filename = Filename;
+
+			hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+			assert( plist_id != HDF5_error );
+			HDF5_status = H5Pset_fapl_mpio(plist_id, Comm, MPI_INFO_NULL);
+			assert( HDF5_status != HDF5_error );
+
+			File_id = H5Fopen(Filename.c_str(), H5F_ACC_RDONLY, plist_id);
+			assert( File_id != HDF5_error );
+
+			HDF5_status = H5Pclose(plist_id);
+			assert( HDF5_status != HDF5_error );
+
+			// every rank reads together, so MPI-IO can aggregate the requests
+			Transfer_id = H5Pcreate(H5P_DATASET_XFER);
+			assert( Transfer_id != HDF5_error );
+			HDF5_status = H5Pset_dxpl_mpio(Transfer_id, H5FD_MPIO_COLLECTIVE);
+			assert( HDF5_status != HDF5_error );
+		}
+#endif
+
 		/**
 		 * close HDF5 file
 		 *
 		 */
 		void close(void)
 		{
+			if (Transfer_id != H5P_DEFAULT)
+			{
+				HDF5_status = H5Pclose(Transfer_id);
+				assert( HDF5_status != HDF5_error );
+				Transfer_id = H5P_DEFAULT;
+			}
+
 			// close HDF5 file
 			HDF5_status = H5Fclose(File_id);
             assert( HDF5_status != HDF5_error );
@@ -131,7 +171,7 @@ class HDFIO
 
 			// read buffer                               //memspaceid //filespaceid
 			HDF5_status = H5Dread( Dataset_id, DataType, H5S_ALL, H5S_ALL,
-						H5P_DEFAULT, DataBuffer );
+						Transfer_id, DataBuffer );
 			assert( HDF5_status != HDF5_error );
 
 			HDF5_status = H5Sclose(Dataspace_id);
@@ -142,6 +182,62 @@ class HDFIO
 
 		}//read
 
+		/**
+		 * read a hyperslab (contiguous block) from a dataset
+		 * @param *DataBuffer pointer to double/float/int array large enough for the block
+		 * @param Datasetname datasetname
+		 * @param Offset start index of the block in each dimension
+		 * @param Count extent of the block in each dimension
+		 * @param DataType (i.e. H5T_STD_I32LE)
+		 *
+		 */
+		void readHyperslab(void* const DataBuffer, const std::string Datasetname,
+				const std::vector<int> Offset, const std::vector<int> Count, const hid_t DataType)
+		{
+			// get dimensional information from dataspace and update HDFSize
+			getDims(Datasetname);
+			assert( static_cast<int>(Offset.size()) == Rank );
+			assert( static_cast<int>(Count.size()) == Rank );
+
+			hsize_t HDFOffset[4], HDFCount[4];
+			for(int i = 0; i < Rank; i++)
+			{
+				HDFOffset[i] = static_cast<hsize_t>(Offset[i]);
+				HDFCount[i] = static_cast<hsize_t>(Count[i]);
+			}
+
+			// open dataset
+			Dataset_id = H5Dopen(File_id, Datasetname.c_str());// H5P_DEFAULT);
+			assert( Dataset_id != HDF5_error );
+
+			// open dataspace and select the block in the file
+			Dataspace_id = H5Dget_space(Dataset_id);
+			assert( Dataspace_id != HDF5_error );
+
+			HDF5_status = H5Sselect_hyperslab(Dataspace_id, H5S_SELECT_SET,
+						HDFOffset, NULL, HDFCount, NULL);
+			assert( HDF5_status != HDF5_error );
+
+			// memory dataspace is just the block itself
+			hid_t Memspace_id = H5Screate_simple(Rank, HDFCount, NULL);
+			assert( Memspace_id != HDF5_error );
+
+			// read buffer
+			HDF5_status = H5Dread( Dataset_id, DataType, Memspace_id, Dataspace_id,
+						Transfer_id, DataBuffer );
+			assert( HDF5_status != HDF5_error );
+
+			HDF5_status = H5Sclose(Memspace_id);
+			assert( HDF5_status != HDF5_error );
+
+			HDF5_status = H5Sclose(Dataspace_id);
+			assert( HDF5_status != HDF5_error );
+
+			HDF5_status = H5Dclose(Dataset_id);
+			assert( HDF5_status != HDF5_error );
+
+		}//readHyperslab
+
 		/**
 		 * overwrite data of an existing dataset
 		 * @param *DataBuffer pointer to double/float/int array containing data to be written
@@ -240,6 +336,54 @@ class HDFIO
 		}
 
 
+		/**
+		 * write HDF5 dataset, deflate compressed in a single chunk (small datasets, e.g. 2D maps)
+		 * @param DataBuffer int/float/double array containing the data
+		 * @param Datasetname datasetname
+		 * @param Dimensions dataset dimensions
+		 * @param DataType (i.e. H5T_IEEE_F32BE, H5T_STD_I32LE, ...)
+		 * @param DeflateLevel gzip level, 1 (fast) to 9 (small)
+		 *
+		 */
+		void writeCompressed(const void* const DataBuffer, const std::string Datasetname,
+				const std::vector<int> Dimensions, const hid_t DataType, const int DeflateLevel)
+		{
+			setDims(Dimensions);
+
+			// -------------- create dataspace
+			Dataspace_id = H5Screate_simple(Rank, HDFDims, NULL);
+			assert( Dataspace_id != HDF5_error );
+
+			// -------------- chunked (the whole dataset) and deflated
+			hid_t plist_id = H5Pcreate(H5P_DATASET_CREATE);
+			assert( plist_id != HDF5_error );
+			HDF5_status = H5Pset_chunk(plist_id, Rank, HDFDims);
+			assert( HDF5_status != HDF5_error );
+			HDF5_status = H5Pset_deflate(plist_id, DeflateLevel);
+			assert( HDF5_status != HDF5_error );
+
+			// -------------- create dataset
+			Dataset_id = H5Dcreate(File_id, Datasetname.c_str(),
+						DataType, Dataspace_id, plist_id);
+			assert( Dataset_id != HDF5_error );
+
+			// -------------- write dataset
+			HDF5_status = H5Dwrite(Dataset_id, DataType,
+					H5S_ALL, H5S_ALL, H5P_DEFAULT, DataBuffer);
+			assert( HDF5_status != HDF5_error );
+
+			// -------------- close dataset, property list and dataspace
+			HDF5_status = H5Dclose(Dataset_id);
+			assert( HDF5_status != HDF5_error );
+
+			HDF5_status = H5Pclose(plist_id);
+			assert( HDF5_status != HDF5_error );
+
+			HDF5_status = H5Sclose(Dataspace_id);
+			assert( HDF5_status != HDF5_error );
+		}
+
+
 		/**
 		 * set the rank of a dataset
 		 * @param Rank the rank, dimensionality (0,1,2)
@@ -0,0 +1,94 @@
+/*
+ * Join tree (merge tree of the sublevel sets) of a scalar field over a block of z-planes,
+ * and a builder that streams a volume too large for memory through in slabs.
+ *
+ * A JoinTree only keeps its critical nodes (minima and join saddles), plus every vertex on
+ * a z-plane that borders a block it hasn't been stitched to yet. Two trees over adjacent
+ * blocks are merged along their shared plane by stitchJoinTrees(), after which the plane
+ * vertices that turned out to be regular are dropped again.
+ *
+ * Vertex order matches Data::less() (value, then flat index) and connectivity matches
+ * Mesh::getNeighbors(), so the result is the join tree libtourtre would build in-core.
+ */
+
+#ifndef JOIN_TREE_H
+#define JOIN_TREE_H
+
+#include <vector>
+#include <cstddef>
+
+#include "Global.h"
+
+struct JoinTree
+{
+    uint size[3];           // dimensions of the whole domain
+    uint z_begin, z_end;    // planes [z_begin, z_end) covered by this tree
+
+    std::vector< size_t > vertex;   // flat mesh index of each node (in the whole domain)
+    std::vector< float > value;     // field value at each node
+    std::vector< VertexId > parent; // next node up the tree, NOTHING for the root
+
+    std::vector< VertexId > bottom_plane;   // node of each x + y*size[0] on plane z_begin
+    std::vector< VertexId > top_plane;      // node of each x + y*size[0] on plane z_end-1
+                                        // (both are left empty at the domain edges)
+
+    JoinTree() : z_begin(0), z_end(0) { size[0] = size[1] = size[2] = 0; }
+
+    VertexId numNodes() const { return vertex.size(); }
+    VertexId countMinima() const;
+    VertexId countSaddles() const;
+    size_t memoryUsage() const;     // bytes held by the node and plane arrays
+};
+
+// signature of the callback that fills slab[] with planes [z_begin, z_begin+num_z), x fastest
+typedef void (*SlabLoader)(uint z_begin, uint num_z, float * slab, void * cbData);
+
+/*
+ * Join tree of a single slab holding planes [z_begin, z_end) of a domain with dimensions size[].
+ * z_begin must be even so the tetrahedral parity of the slab matches the whole domain.
+ * The slab is sorted and swept in place, it is not copied (nor modified).
+ */
+void buildSlabJoinTree(const float * slab, const uint size[3],
+                       const uint z_begin, const uint z_end, JoinTree & tree);
+
+/*
+ * Join tree of the union of two adjacent blocks (lower.z_end == upper.z_begin)
+ */
+void stitchJoinTrees(const JoinTree & lower, const JoinTree & upper, JoinTree & merged);
+
+/*
+ * True if both trees have the same nodes (by mesh vertex) connected by the same arcs
+ */
+bool sameJoinTree(const JoinTree & a, const JoinTree & b);
+
+
+class OutOfCoreJoinTree
+{
+    private:
+        uint size[3];
+        size_t memory_budget;   // in bytes
+        uint slab_depth;        // planes read per block
+        size_t peak_memory;     // estimated high-water mark of the last build()
+
+        SlabLoader loader;
+        void * loader_data;
+
+        OutOfCoreJoinTree();    // private default ctor --> Don't use
+
+    public:
+
+        // approx. bytes needed per slab vertex: float buffer (wrapped by Data), order and sweep arrays
+        static const size_t bytes_per_vertex = 24;
+
+        OutOfCoreJoinTree(const uint dims[3],
+                          const size_t budget,
+                          SlabLoader load,
+                          void * cbData);    // ctor
+
+        void build(JoinTree & tree);
+
+        uint getSlabDepth() const { return slab_depth; }
+        size_t getPeakMemory() const { return peak_memory; }
+};
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * Bit-packed per-cell labels (Bits = 2 or 4 bits each, 32 or 16 cells per 64 bit word).
+ *
+ * Whole words are queried at once (SWAR): matchMask() turns a word into one bit per cell
+ * whose label equals k, so counting or listing the cells with a label skips 32 cells at a
+ * time; per-cell queries (get, labelsOf) stay scalar. Updates come in a plain and an atomic
+ * (compare-and-swap on the word) flavour, for labelling passes where several threads write
+ * cells that share a word.
+ */
+
+#ifndef LABEL_VOLUME_H
+#define LABEL_VOLUME_H
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+#include "Global.h"
+
+template <unsigned int Bits>
+class LabelVolume
+{
+    private:
+        typedef char bits_must_be_2_or_4[(Bits == 2 || Bits == 4) ? 1 : -1];
+
+        static const unsigned int per_word = 64 / Bits;
+        static const uint64_t field = (uint64_t(1) << Bits) - 1;
+
+        std::vector< uint64_t > words;
+        VertexId num_cells;
+
+        // the low bit of every field
+        static uint64_t lows()
+        {
+            uint64_t l = 0;
+            for (unsigned int f = 0; f < per_word; ++f) l |= uint64_t(1) << (f * Bits);
+            return l;
+        }
+
+        static size_t wordOf(const VertexId i) { return i / per_word; }
+        static unsigned int shiftOf(const VertexId i) { return (i % per_word) * Bits; }
+
+        // first and last cells of words[w] that are inside the volume
+        uint64_t validMask(const size_t w) const
+        {
+            const VertexId left = num_cells - VertexId(w) * per_word;
+            if (left >= per_word) return ~uint64_t(0);
+            return (uint64_t(1) << (left * Bits)) - 1;
+        }
+
+    public:
+        typedef unsigned char Label;
+        static const Label max_label = (1 << Bits) - 1;
+
+        LabelVolume() : num_cells(0) {}
+        explicit LabelVolume(const VertexId n, const Label initial = 0) { reset(n, initial); }
+
+        void reset(const VertexId n, const Label initial = 0)
+        {
+            num_cells = n;
+            words.assign((n + per_word - 1) / per_word, lows() * initial);
+        }
+
+        VertexId size() const { return num_cells; }
+        size_t memoryUsage() const { return words.capacity() * sizeof(uint64_t); }
+
+        Label get(const VertexId i) const
+        {
+            return (words[wordOf(i)] >> shiftOf(i)) & field;
+        }
+
+        void set(const VertexId i, const Label k)
+        {
+            uint64_t & w = words[wordOf(i)];
+            const unsigned int s = shiftOf(i);
+            w = (w & ~(field << s)) | (uint64_t(k) << s);
+        }
+
+        // thread-safe set(): retries until no other thread changed the word in between
+        void setAtomic(const VertexId i, const Label k)
+        {
+            uint64_t * w = &words[wordOf(i)];
+            const unsigned int s = shiftOf(i);
+            uint64_t old_word = *w;
+            for (;;) {
+                const uint64_t new_word = (old_word & ~(field << s)) | (uint64_t(k) << s);
+                const uint64_t seen = __sync_val_compare_and_swap(w, old_word, new_word);
+                if (seen == old_word) return;
+                old_word = seen;
+            }
+        }
+
+        // sets cell i to k only if it is still expected, returns false if another thread won
+        bool compareAndSet(const VertexId i, const Label expected, const Label k)
+        {
+            uint64_t * w = &words[wordOf(i)];
+            const unsigned int s = shiftOf(i);
+            uint64_t old_word = *w;
+            for (;;) {
+                if (((old_word >> s) & field) != expected) return false;
+                const uint64_t new_word = (old_word & ~(field << s)) | (uint64_t(k) << s);
+                const uint64_t seen = __sync_val_compare_and_swap(w, old_word, new_word);
+                if (seen == old_word) return true;
+                old_word = seen;
+            }
+        }
+
+        // low bit of each field set where the field equals k
+        static uint64_t matchMask(const uint64_t word, const Label k)
+        {
+            uint64_t x = word ^ (lows() * k);   // zero fields are the matches
+            x |= x >> 1;
+            if (Bits == 4) x |= x >> 2;
+            return ~x & lows();
+        }
+
+        // bit k of the result is set if any of the n cells is labelled k. Scalar, one get() per
+        // cell: neighbour lists come in stencil order, so their ids rarely share a word
+        unsigned int labelsOf(const VertexId * ids, const size_t n) const
+        {
+            unsigned int seen = 0;
+            for (size_t j = 0; j < n; ++j) seen |= 1u << get(ids[j]);
+            return seen;
+        }
+
+        bool anyLabelled(const VertexId * ids, const size_t n, const Label k) const
+        {
+            for (size_t j = 0; j < n; ++j)
+                if (get(ids[j]) == k) return true;
+            return false;
+        }
+
+        VertexId count(const Label k) const
+        {
+            VertexId total = 0;
+            for (size_t w = 0; w < words.size(); ++w)
+                total += __builtin_popcountll(matchMask(words[w], k) & validMask(w));
+            return total;
+        }
+
+        // appends every cell labelled k, in index order
+        void indicesOf(const Label k, std::vector< VertexId > & out) const
+        {
+            for (size_t w = 0; w < words.size(); ++w) {
+                uint64_t m = matchMask(words[w], k) & validMask(w);
+                while (m != 0) {
+                    const unsigned int bit = __builtin_ctzll(m);
+                    out.push_back(VertexId(w) * per_word + bit / Bits);
+                    m &= m - 1;
+                }
+            }
+        }
+};
+
+#endif
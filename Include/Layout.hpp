@@ -0,0 +1,130 @@
+/*
+ * Memory layouts of a 3D field, as policies for Data<T, L> and Mesh<T, L>.
+ *
+ * A vertex id is the position of the cell in storage, so with a Brick or Morton layout the
+ * neighbours of a cell mostly sit in the same few cache lines and pages, instead of a whole
+ * row or plane away as in row-major order. Every policy maps (x, y, z) <-> id and converts
+ * ids back to the row-major index the other fields (dens, vel*, ...) are stored in.
+ */
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdint.h>
+
+#include "Global.h"
+
+enum LayoutType { ROW_MAJOR_LAYOUT, BRICK_LAYOUT, MORTON_LAYOUT };
+
+// x fastest, then y, then z -- the layout of the FLASH extracts
+struct RowMajor
+{
+    static const char * name() { return "row-major"; }
+    static bool fits(const uint *) { return true; }
+
+    static VertexId index(const uint x, const uint y, const uint z, const uint * size)
+    {
+        return (VertexId(z) * size[1] + y) * size[0] + x;
+    }
+
+    static void coords(const VertexId id, const uint * size, uint & x, uint & y, uint & z)
+    {
+        const VertexId size01 = VertexId(size[0]) * size[1];
+        z = id / size01;
+        y = (id - z*size01) / size[0];
+        x = id - z*size01 - y*size[0];
+    }
+
+    static VertexId toRowMajor(const VertexId id, const uint *) { return id; }
+};
+
+// 8^3 bricks in row-major order, cells row-major inside each brick (one 2 kB float brick)
+struct Brick
+{
+    static const uint edge = 8;
+    static const uint cells = edge * edge * edge;
+
+    static const char * name() { return "brick (8^3)"; }
+    static bool fits(const uint * size)
+    {
+        return size[0] % edge == 0 && size[1] % edge == 0 && size[2] % edge == 0;
+    }
+
+    static VertexId index(const uint x, const uint y, const uint z, const uint * size)
+    {
+        const VertexId brick = (VertexId(z / edge) * (size[1] / edge) + y / edge) * (size[0] / edge) + x / edge;
+        return brick * cells + ((z % edge) * edge + y % edge) * edge + x % edge;
+    }
+
+    static void coords(const VertexId id, const uint * size, uint & x, uint & y, uint & z)
+    {
+        const VertexId brick = id / cells;
+        const uint cell = id % cells;
+        const uint bx = size[0] / edge;
+        const uint by = size[1] / edge;
+        x = (brick % bx) * edge + cell % edge;
+        y = ((brick / bx) % by) * edge + (cell / edge) % edge;
+        z = (brick / (VertexId(bx) * by)) * edge + cell / (edge * edge);
+    }
+
+    static VertexId toRowMajor(const VertexId id, const uint * size)
+    {
+        uint x, y, z;
+        coords(id, size, x, y, z);
+        return RowMajor::index(x, y, z, size);
+    }
+};
+
+// Z-order curve (bits of x, y, z interleaved), for cubes with a power of 2 edge
+struct Morton
+{
+    static const char * name() { return "Morton"; }
+    static bool fits(const uint * size)
+    {
+        return size[0] == size[1] && size[1] == size[2] && (size[0] & (size[0] - 1)) == 0;
+    }
+
+    // 21 low bits of v moved to every third bit
+    static uint64_t spread(uint64_t v)
+    {
+        v &= 0x1fffff;
+        v = (v | v << 32) & 0x1f00000000ffffULL;
+        v = (v | v << 16) & 0x1f0000ff0000ffULL;
+        v = (v | v << 8)  & 0x100f00f00f00f00fULL;
+        v = (v | v << 4)  & 0x10c30c30c30c30c3ULL;
+        v = (v | v << 2)  & 0x1249249249249249ULL;
+        return v;
+    }
+
+    static uint compact(uint64_t v)
+    {
+        v &= 0x1249249249249249ULL;
+        v = (v ^ (v >> 2))  & 0x10c30c30c30c30c3ULL;
+        v = (v ^ (v >> 4))  & 0x100f00f00f00f00fULL;
+        v = (v ^ (v >> 8))  & 0x1f0000ff0000ffULL;
+        v = (v ^ (v >> 16)) & 0x1f00000000ffffULL;
+        v = (v ^ (v >> 32)) & 0x1fffff;
+        return v;
+    }
+
+    static VertexId index(const uint x, const uint y, const uint z, const uint *)
+    {
+        return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+    }
+
+    static void coords(const VertexId id, const uint *, uint & x, uint & y, uint & z)
+    {
+        x = compact(id);
+        y = compact(uint64_t(id) >> 1);
+        z = compact(uint64_t(id) >> 2);
+    }
+
+    static VertexId toRowMajor(const VertexId id, const uint * size)
+    {
+        uint x, y, z;
+        coords(id, size, x, y, z);
+        return RowMajor::index(x, y, z, size);
+    }
+};
+
+#endif
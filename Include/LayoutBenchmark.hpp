@@ -0,0 +1,17 @@
+/*
+ * Neighbour-gather throughput of a field in each memory layout (see Layout.hpp): the time
+ * to sort the vertices, then to gather the values of every vertex's Mesh neighbours, once
+ * in storage order and once in sweep (sorted) order, which is what libtourtre does.
+ */
+
+#ifndef LAYOUT_BENCHMARK_H
+#define LAYOUT_BENCHMARK_H
+
+#include <ostream>
+
+#include "Global.h"
+
+// values are row-major, size[] = { nx, ny, nz }
+void benchmarkNeighborGather(const float * values, const uint size[3], std::ostream & out);
+
+#endif
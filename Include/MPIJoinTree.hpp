@@ -0,0 +1,54 @@
+/*
+ * Distributed-memory join tree construction (compile with -DUSE_MPI).
+ *
+ * The grid is split into z-slabs, one per rank, each starting on an even plane. Every rank
+ * reads and sweeps only its own slab, then the boundary trees are merged pairwise up a
+ * binary reduction tree with stitchJoinTrees(), so rank 0 ends up with the global tree.
+ */
+
+#ifndef MPI_JOIN_TREE_H
+#define MPI_JOIN_TREE_H
+
+#ifdef USE_MPI
+
+#include <mpi.h>
+
+#include "JoinTree.hpp"
+
+class MPIJoinTree
+{
+    private:
+        uint size[3];
+        MPI_Comm comm;
+        int rank, num_ranks;
+        uint z_begin, z_end;    // planes owned by this rank
+
+        SlabLoader loader;      // called collectively, once per rank, for [z_begin, z_end)
+        void * loader_data;
+
+        void ownedPlanes(const int r, uint & zb, uint & ze) const;
+
+        MPIJoinTree();    // private default ctor --> Don't use
+
+    public:
+
+        MPIJoinTree(const uint dims[3],
+                    MPI_Comm communicator,
+                    SlabLoader load,
+                    void * cbData);    // ctor
+
+        // returns true on the rank holding the global tree (rank 0)
+        // verify: gather the field to rank 0 and compare with a single-process build
+        bool build(JoinTree & tree, const bool verify = false);
+
+        uint getZBegin() const { return z_begin; }
+        uint getZEnd() const { return z_end; }
+};
+
+// point-to-point transfer of a (boundary) tree between ranks
+void sendJoinTree(const JoinTree & tree, const int dest, MPI_Comm comm);
+void recvJoinTree(JoinTree & tree, const int source, MPI_Comm comm);
+
+#endif  // USE_MPI
+
+#endif
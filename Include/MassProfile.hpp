@@ -0,0 +1,39 @@
+/*
+ * Mass profile of a core against the gpot level that bounds it. The cells come sorted by
+ * gpot, so the region below level l is a prefix of them: cumulative cells, volume, mass and
+ * momentum are prefix sums built in one pass. The bound mass at a level depends on that
+ * region's CoM and reference gpot, so it is evaluated per output level, the levels in
+ * parallel.
+ */
+
+#ifndef MASS_PROFILE_H
+#define MASS_PROFILE_H
+
+#include <vector>
+#include <ostream>
+#include <cstddef>
+
+#include "Global.h"
+#include "BoundMass.hpp"
+
+struct ProfileRow
+{
+    double gpot_level;      // every cell with gpot <= this is in the region
+    size_t cells;
+    double volume;          // cm^3
+    double mass;            // g
+    double px, py, pz;      // g cm/s
+    size_t bound_cells;
+    double bound_mass;      // g, relative to the region's CoM and max gpot
+};
+
+/*
+ * One row per level, num_levels of them evenly spaced from the lowest to the highest gpot of
+ * sorted (row-major ids in ascending gpot order, e.g. a core region)
+ */
+void thresholdProfile(const CellEnergetics & e, const std::vector< VertexId > & sorted,
+                      const unsigned int num_levels, std::vector< ProfileRow > & rows);
+
+void writeProfile(const std::vector< ProfileRow > & rows, std::ostream & out);
+
+#endif
@@ -5,25 +5,73 @@
 
 #include "Global.h"
 #include "Data.h"
+#include "Stencil.hpp"
 
 //abstract mesh class
+template <typename T, typename L = RowMajor>
 class Mesh 
 {
 	public:
 	
-	Data & data;
-	Mesh(Data & d) : data(d) {}
+	Data<T, L> & data;
+	Mesh(Data<T, L> & d) : data(d) {}
 	
-	void getNeighbors(size_t i, std::vector<size_t> & n);
-    void getNeighbors18(size_t i, std::vector<size_t> & n);
-	void createGraph(std::vector<size_t> & order);
+	void getNeighbors(VertexId i, std::vector<VertexId> & n);
+	void getNeighbors18(VertexId i, std::vector<VertexId> & n);
+	void getNeighbors26(VertexId i, std::vector<VertexId> & n);
+	void createGraph(std::vector<VertexId> & order);
 	uint numVerts();
 	
 	
 
-	void find6Neighbors( uint x, uint y, uint z, std::vector< size_t > & neighbors);
-	void find18Neighbors( uint x, uint y, uint z, std::vector< size_t > & neighbors);
+	void find6Neighbors( uint x, uint y, uint z, std::vector< VertexId > & neighbors);
+	void find18Neighbors( uint x, uint y, uint z, std::vector< VertexId > & neighbors);
+	
+	//calls visit(id) for every neighbour of i under connectivity Conn (see Stencil.hpp),
+	//unrolled and without touching the heap
+	template <int Conn, typename Visitor>
+	void visitNeighbors(VertexId i, Visitor & visit) {
+		uint x,y,z;
+		data.convertIndex( i, x, y, z );
+		visitStencil<Conn, L>( x, y, z, data.size, visit );
+	}
+	
+	//writes the neighbours of i to out, returns how many
+	template <int Conn>
+	size_t neighborsOf(VertexId i, size_t * out) {
+		ArrayFill fill = { out, 0 };
+		visitNeighbors<Conn>( i, fill );
+		return fill.n;
+	}
+	
+	private:
+	
+	struct ArrayFill {
+		size_t * out;
+		size_t n;
+		void operator()(VertexId id) { out[n++] = id; }
+	};
+	
+	struct VectorFill {
+		std::vector< VertexId > & out;
+		void operator()(VertexId id) { out.push_back( id ); }
+	};
 	
 };
 
+//libtourtre takes size_t vertex ids: hands ct_init() the order as is when VertexId is size_t,
+//else widens it into wide and releases the compact copy
+inline size_t * widenOrder( std::vector<size_t> & order, std::vector<size_t> & ) 
+{
+	return &order.front();
+}
+
+template <typename Id>
+inline size_t * widenOrder( std::vector<Id> & order, std::vector<size_t> & wide ) 
+{
+	wide.assign( order.begin(), order.end() );
+	std::vector<Id>().swap( order );
+	return &wide.front();
+}
+
 #endif
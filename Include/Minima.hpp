@@ -0,0 +1,52 @@
+/*
+ * Local minima of a field on the Mesh stencil, and the basin (elder rule) hierarchy that
+ * pairs every minimum with the join saddle where it merges into an older, deeper basin.
+ *
+ * Both use the same vertex order as Data::less() and the same connectivity as
+ * Mesh::getNeighbors(), so the minima are exactly the leaves of the libtourtre join tree.
+ * They work on a PaddedField, so neighbours are constant offsets and need no bounds checks.
+ */
+
+#ifndef MINIMA_H
+#define MINIMA_H
+
+#include <vector>
+#include <cstddef>
+
+#include "Global.h"
+#include "PaddedField.hpp"
+
+struct Basins
+{
+    std::vector< VertexId > minimum;    // vertex of each local minimum (its id is the position)
+    std::vector< VertexId > merged_into;    // id of the elder minimum that absorbed it (NOTHING: never)
+    std::vector< double > saddle;       // value at which it was absorbed
+    std::vector< double > persistence;  // saddle - value at the minimum
+    std::vector< VertexId > label;      // per vertex: id of the minimum whose basin it joined
+
+    VertexId numMinima() const { return minimum.size(); }
+
+    // the minimum id's cells end up with, once every basin below threshold is merged away
+    VertexId survivor(VertexId id, const double threshold) const
+    {
+        while (merged_into[id] != NOTHING && persistence[id] < threshold)
+            id = merged_into[id];
+        return id;
+    }
+};
+
+/*
+ * Stencil pass over the whole grid, every row compared branch-free against constant offsets
+ * so the loop vectorizes. Minima are returned as row-major ids.
+ */
+template <typename T>
+void findLocalMinima(const PaddedField<T> & field, std::vector< VertexId > & minima);
+
+/*
+ * Union-find sweep in the given (ascending) order, seeded with the minima found above
+ */
+template <typename T>
+void computeBasins(const PaddedField<T> & field, const std::vector< VertexId > & order,
+                   const std::vector< VertexId > & minima, Basins & basins);
+
+#endif
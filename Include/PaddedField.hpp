@@ -0,0 +1,112 @@
+/*
+ * Copy of a row-major field with one layer of ghost cells on every face, all holding a
+ * sentinel (+inf by default). Every interior cell then has all 18 of its Mesh neighbours
+ * in storage at constant linear offsets, so stencil loops run without bounds checks; the
+ * sentinel makes ghosts lose every comparison a sweep from below would make.
+ *
+ * Padded indices are ordered like row-major ones (z, then y, then x), so ties between
+ * interior cells can be broken on either.
+ */
+
+#ifndef PADDED_FIELD_H
+#define PADDED_FIELD_H
+
+#include <vector>
+#include <limits>
+#include <cstddef>
+
+#include "Global.h"
+#include "VolumeView.hpp"
+
+template <typename T>
+class PaddedField
+{
+    public:
+        uint size[3];       // interior dimensions
+        uint padded[3];     // size + 2
+        long stride_y, stride_z;
+        T ghost;
+        T minValue, maxValue;   // over the interior
+        std::vector< T > values;
+
+        // face neighbours, then the 12 edge neighbours of the 18 stencil, lower indices first
+        long face[6];
+        long edge[12];
+
+        PaddedField() : stride_y(0), stride_z(0) { size[0] = size[1] = size[2] = 0; }
+
+        static T defaultGhost()
+        {
+            return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                                        : std::numeric_limits<T>::max();
+        }
+
+        void load(const T * rowmajor, const uint dims[3], const T ghost_value = defaultGhost())
+        {
+            load(gridView(rowmajor, dims), ghost_value);
+        }
+
+        // a box of a larger grid, ids are then row-major within the box (box.cellIndex() maps
+        // back); U is T or const T, so a FieldStore view goes straight in
+        template <typename U>
+        void load(const VolumeView<U> & box, const T ghost_value = defaultGhost())
+        {
+            for (int d = 0; d < 3; ++d) {
+                size[d] = box.extent[d];
+                padded[d] = box.extent[d] + 2;
+            }
+            stride_y = padded[0];
+            stride_z = long(padded[0]) * padded[1];
+            ghost = ghost_value;
+            values.assign(size_t(stride_z) * padded[2], ghost);
+
+            minValue = maxValue = box(0, 0, 0);
+            for (uint z = 0; z < size[2]; ++z)
+                for (uint y = 0; y < size[1]; ++y) {
+                    T * row = &values[pad(0, y, z)];
+                    const T * src = &box(0, y, z);
+                    for (uint x = 0; x < size[0]; ++x) {
+                        const T v = src[x * box.stride[0]];
+                        row[x] = v;
+                        if (v < minValue) minValue = v;
+                        if (v > maxValue) maxValue = v;
+                    }
+                }
+
+            const long f[6] = { -stride_z, -stride_y, -1, 1, stride_y, stride_z };
+            const long e[12] = { -stride_z-stride_y, -stride_z-1, -stride_z+1, -stride_z+stride_y,
+                                 -stride_y-1, -stride_y+1, stride_y-1, stride_y+1,
+                                 stride_z-stride_y, stride_z-1, stride_z+1, stride_z+stride_y };
+            for (int i = 0; i < 6; ++i) face[i] = f[i];
+            for (int i = 0; i < 12; ++i) edge[i] = e[i];
+        }
+
+        VertexId pad(const uint x, const uint y, const uint z) const
+        {
+            return (VertexId(z + 1) * padded[1] + (y + 1)) * padded[0] + (x + 1);
+        }
+
+        // row-major interior id <-> padded index
+        VertexId pad(const VertexId v) const
+        {
+            const VertexId size01 = VertexId(size[0]) * size[1];
+            const uint z = v / size01;
+            const uint y = (v - z*size01) / size[0];
+            return pad(v - z*size01 - y*size[0], y, z);
+        }
+
+        VertexId unpad(const VertexId p) const
+        {
+            const uint z = p / stride_z - 1;
+            const uint y = (p % stride_z) / stride_y - 1;
+            const uint x = p % stride_y - 1;
+            return (VertexId(z) * size[1] + y) * size[0] + x;
+        }
+
+        // value of a row-major interior cell
+        T at(const VertexId v) const { return values[pad(v)]; }
+
+        size_t memoryUsage() const { return values.capacity() * sizeof(T); }
+};
+
+#endif
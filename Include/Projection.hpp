@@ -0,0 +1,49 @@
+/*
+ * Projections of a box of the grid along x, y and z: column density, the mass-weighted
+ * line-of-sight velocity and its dispersion, and an overlay of a cell mask (the core region).
+ *
+ * All three axes come out of one streaming pass over the box, with no transposes: in a
+ * row-major box the x projection reduces each contiguous row, the y projection adds whole
+ * rows into a row of its map, and the z projection adds whole planes into its map. The box's
+ * z planes are split among the threads; the x and y maps get disjoint rows per plane, the z
+ * map is summed in per-thread copies, merged in thread order.
+ *
+ * Map k is the projection along axis k, dims[0] (fastest) and dims[1] are the box extents of
+ * the other two axes in increasing order: (y, z) for x, (x, z) for y, (x, y) for z.
+ */
+
+#ifndef PROJECTION_H
+#define PROJECTION_H
+
+#include <vector>
+#include <string>
+
+#include "Global.h"
+#include "VolumeView.hpp"
+#include "LabelVolume.hpp"
+
+class HDFIO;    // forward dec.
+
+struct ProjectionMap
+{
+    uint dims[2];
+    std::vector< float > column;            // g/cm^2
+    std::vector< float > v_los;             // mass-weighted, cm/s
+    std::vector< float > sigma_los;         // mass-weighted dispersion, cm/s
+    std::vector< float > mask_fraction;     // of the column mass in masked cells
+    std::vector< unsigned char > mask;      // 1 where the line of sight crosses a masked cell
+
+    size_t size() const { return size_t(dims[0]) * dims[1]; }
+};
+
+/*
+ * box gives the geometry (offset, extent, strides) of the box in the row-major grid that
+ * dens, vel[0..2] and mask (cells labelled non-zero, may be NULL) all cover
+ */
+void projectBox(const VolumeView<float> & box, const float * dens, const float * const vel[3],
+                const LabelVolume<2> * mask, const double cell_size, ProjectionMap maps[3]);
+
+// datasets <prefix>_<x|y|z>_<quantity>, float maps deflated, the mask as bytes
+void writeProjections(HDFIO & file, const std::string prefix, const ProjectionMap maps[3]);
+
+#endif
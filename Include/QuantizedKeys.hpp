@@ -0,0 +1,48 @@
+/*
+ * Integer sort keys for a float field, so the vertex order can be built with a radix sort
+ * and the sweep compares narrow integers instead of floats.
+ *
+ *  - 32 bit keys are an exact, order-preserving image of the floats: the order is the one
+ *    Data<float>::less() gives, bit for bit.
+ *  - 16 bit keys quantize [min, max] linearly. Values that land in the same bin become ties
+ *    (broken by index like any other tie), which can move saddles; countAddedTies() reports
+ *    how many neighbouring pairs in the order were affected.
+ */
+
+#ifndef QUANTIZED_KEYS_H
+#define QUANTIZED_KEYS_H
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+#include <cstring>  // memcpy
+
+#include "Global.h"
+
+// flips the sign bit of positives and every bit of negatives, so unsigned order == float order
+inline uint32_t floatKey(float f)
+{
+    if (f == 0.0f) f = 0.0f;    // -0 and +0 compare equal, so they must share a key
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+void makeFloatKeys(const float * values, const size_t n, std::vector< uint32_t > & keys);
+void makeLinearKeys(const float * values, const size_t n, std::vector< uint16_t > & keys);
+
+/*
+ * Stable LSD radix sort of the vertex ids by key, one byte per pass. Starting from the
+ * identity, equal keys stay in index order -- the same tie-break as Data::less().
+ */
+template <typename K>
+void radixSortOrder(const std::vector< K > & keys, std::vector< VertexId > & order);
+
+/*
+ * Neighbouring pairs in order whose keys are equal although their values are not
+ */
+template <typename K>
+size_t countAddedTies(const float * values, const std::vector< K > & keys,
+                      const std::vector< VertexId > & order);
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * Radial profiles (density, radial and tangential velocity, enclosed mass) around a set of
+ * centres, usually the sink particles, all of them in one sweep over the grid.
+ *
+ * Bins are log-spaced from r_min to r_max; the first also takes the cells closer than r_min.
+ * The grid is swept a z plane at a time, the planes split among the threads. For every
+ * centre whose sphere of radius r_max reaches a plane, only the rows it crosses are visited,
+ * and of each row only the run of x it covers, so a cell is read once per centre that covers
+ * it and the cost goes with the volume of the spheres, not the number of centres times the
+ * grid. Each thread adds into its own histograms, merged in thread order at the end.
+ */
+
+#ifndef RADIAL_PROFILE_H
+#define RADIAL_PROFILE_H
+
+#include <vector>
+#include <ostream>
+#include <cstddef>
+
+#include "Global.h"
+
+struct RadialCentre
+{
+    double pos[3];      // cm
+    double vel[3];      // cm/s, the velocities are taken relative to it
+};
+
+struct RadialBin
+{
+    double r_inner, r_outer;    // cm
+    size_t cells;
+    double mass;                // g
+    double mass_vr;             // sum m v_r, g cm/s (v_r > 0 outwards)
+    double mass_vr2;            // sum m v_r^2
+    double mass_vt2;            // sum m v_t^2, the tangential part
+    double enclosed_mass;       // g, this bin and every one inside it
+};
+
+/*
+ * dens and vel[0..2] are row-major fields of size[] cells, origin = minmax_xyz[0], [2], [4];
+ * profiles gets num_bins bins per centre
+ */
+void radialProfiles(const float * dens, const float * const vel[3], const uint size[3],
+                    const double origin[3], const double cell_size,
+                    const std::vector< RadialCentre > & centres, const double r_min,
+                    const double r_max, const uint num_bins,
+                    std::vector< std::vector< RadialBin > > & profiles);
+
+void writeRadialProfiles(const std::vector< std::vector< RadialBin > > & profiles,
+                         const double cell_vol, std::ostream & out);
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * Per-label statistics of a labelled grid (cores, clumps, sink Voronoi cells, ...), for every
+ * label at once in one sweep over the grid.
+ *
+ * Each thread sweeps its own z planes into its own RegionMoments per label (raw mass-weighted
+ * moments, which add), and the threads' moments are merged at the end, so the cost is
+ * O(cells) + O(threads x labels) however many labels there are. When threads x labels
+ * moments would take more than the budget (~180 bytes each), the cells are bucketed by label
+ * instead and each label is reduced by one thread, for O(cells) extra memory and a serial
+ * bucketing pass.
+ *
+ * regionStats() turns a label's moments into CoM, angular momentum, dispersion, inertia tensor
+ * and energies. Positions are accumulated in cells from the grid centre, which keeps the
+ * central moments accurate for any region more than a few cells across.
+ */
+
+#ifndef REGION_STATS_H
+#define REGION_STATS_H
+
+#include <vector>
+#include <cstddef>
+
+#include "Global.h"
+#include "BoundMass.hpp"
+
+const size_t REGION_MOMENTS_BUDGET = size_t(1) << 28;     // bytes of per-thread moments
+
+// mass-weighted sums over the cells of one label
+struct RegionMoments
+{
+    size_t cells;
+    double mass;
+    double mx[3];       // sum m x
+    double p[3];        // sum m v
+    double xp[3];       // sum m x cross v
+    double mxx[6];      // sum m x_i x_j: xx yy zz xy xz yz
+    double mvv;         // sum m v.v
+    double meint;       // sum m eint
+    double mgpot;       // sum m gpot
+    double gpot_max;
+
+    RegionMoments();
+    void merge(const RegionMoments & other);
+};
+
+struct RegionStats
+{
+    size_t cells;
+    double volume;          // cm^3
+    double mass;            // g
+    double com[3];          // cm
+    double com_vel[3];      // cm/s
+    double L[3];            // about the CoM, g cm^2/s
+    double sigma_v;         // 1D mass-weighted velocity dispersion, cm/s
+    double inertia[6];      // tensor about the CoM, g cm^2: xx yy zz xy xz yz
+    double Ekin;            // relative to the CoM velocity, erg
+    double Etherm;
+    double Egrav;           // sum m gpot - M gpot_max, relative to the region's max gpot
+    double gpot_max;
+
+    double virialRatio() const;
+};
+
+/*
+ * labels[i] (row-major, size[] cells) is the label of cell i; cells labelled num_labels or
+ * more (NOTHING, say) belong to none. moments gets num_labels entries.
+ */
+void reduceRegions(const CellEnergetics & e, const uint size[3], const VertexId * labels,
+                   const VertexId num_labels, std::vector< RegionMoments > & moments,
+                   const size_t budget = REGION_MOMENTS_BUDGET);
+
+// cell_size in cm, origin = minmax_xyz[0], [2], [4] (the lower grid corner)
+void regionStats(const RegionMoments & m, const uint size[3], const double cell_size,
+                 const double origin[3], const double cell_vol, RegionStats & stats);
+
+#endif
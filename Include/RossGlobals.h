@@ -2,7 +2,11 @@
 #define ROSS_HEADER_H
 
 #include "HDFIO.h"
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
 #include <string>
+#include <vector>
 
 extern hid_t HDFDataType;   // set by calling CheckMachineFor...() below
 extern bool HDFDataType_is_set;     // ...only need to call it once
@@ -32,6 +36,26 @@ void CheckMachineForLittleBigEndianNumerics(void);
  */
 void loadArrayFromHDF(float* data, std::string filename, std::string dataset_name);
 
+/*
+ * Planes [z_begin, z_begin+num_z) of a 3D dataset (stored z-slowest) are loaded into *data
+ */
+void loadSlabFromHDF(float* data, std::string filename, std::string dataset_name,
+                     const unsigned int z_begin, const unsigned int num_z);
+
+#ifdef USE_MPI
+/*
+ * As above, but called collectively by every rank in comm, each for its own planes
+ * (through collective MPI-IO reads when HDF5 was built with parallel support)
+ */
+void loadSlabFromHDF(float* data, std::string filename, std::string dataset_name,
+                     const unsigned int z_begin, const unsigned int num_z, MPI_Comm comm);
+#endif
+
+/*
+ * Returns the dimensions of a dataset without reading it (slowest varying first)
+ */
+std::vector<int> getDimsFromHDF(std::string filename, std::string dataset_name);
+
 /*
  * Print the contents of an STL container
  */
@@ -0,0 +1,73 @@
+/*
+ * Compile-time neighbour stencils for the regular grid.
+ *
+ * Stencil<Conn, Parity> gives the number of neighbours as a constant expression, and
+ * StencilLoop unrolls the visit of each of them at compile time: no offset arrays are built
+ * and nothing is allocated per vertex. Out-of-grid neighbours are skipped with the same
+ * unsigned wrap-around test Mesh has always used.
+ *
+ *  CONN_6    face neighbours
+ *  CONN_18   face + edge neighbours
+ *  CONN_26   face + edge + corner neighbours
+ *  CONN_TET  6 for odd-parity cells, 18 for even ones -- the tetrahedral mesh libtourtre
+ *            has always been given through Mesh::getNeighbors()
+ */
+
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#include "Global.h"
+
+enum Connectivity { CONN_6 = 6, CONN_18 = 18, CONN_26 = 26, CONN_TET = 0 };
+
+// 6 faces, 12 edges (in Mesh::find18Neighbors order), then the 8 corners
+constexpr int stencil_offsets[26][3] = {
+    {-1, 0, 0}, { 0,-1, 0}, { 0, 0,-1}, { 1, 0, 0}, { 0, 1, 0}, { 0, 0, 1},
+    {-1,-1, 0}, { 1,-1, 0}, { 0,-1,-1}, { 0, 1,-1}, {-1, 0,-1}, {-1, 0, 1},
+    {-1, 1, 0}, { 1, 1, 0}, { 0,-1, 1}, { 0, 1, 1}, { 1, 0,-1}, { 1, 0, 1},
+    {-1,-1,-1}, { 1,-1,-1}, {-1, 1,-1}, { 1, 1,-1},
+    {-1,-1, 1}, { 1,-1, 1}, {-1, 1, 1}, { 1, 1, 1}
+};
+
+template <int Conn, int Parity>
+struct Stencil
+{
+    static constexpr int size = (Conn != CONN_TET) ? Conn
+                              : (Parity == ODD_TET_PARITY ? 6 : 18);
+};
+
+// visits neighbours I .. N-1 of (x, y, z), passing each one's id in layout L to visit()
+template <int I, int N>
+struct StencilLoop
+{
+    template <typename L, typename Visitor>
+    static inline void visit(const uint x, const uint y, const uint z, const uint * size,
+                             Visitor & visitor)
+    {
+        const uint nx = x + stencil_offsets[I][0];
+        const uint ny = y + stencil_offsets[I][1];
+        const uint nz = z + stencil_offsets[I][2];
+        if (nx < size[0] && ny < size[1] && nz < size[2])
+            visitor(L::index(nx, ny, nz, size));
+        StencilLoop<I + 1, N>::template visit<L>(x, y, z, size, visitor);
+    }
+};
+
+template <int N>
+struct StencilLoop<N, N>
+{
+    template <typename L, typename Visitor>
+    static inline void visit(const uint, const uint, const uint, const uint *, Visitor &) {}
+};
+
+// all neighbours of (x, y, z) under connectivity Conn, the parity picked at run time
+template <int Conn, typename L, typename Visitor>
+inline void visitStencil(const uint x, const uint y, const uint z, const uint * size, Visitor & visitor)
+{
+    if ((x + y + z) % 2 == ODD_TET_PARITY)
+        StencilLoop<0, Stencil<Conn, ODD_TET_PARITY>::size>::template visit<L>(x, y, z, size, visitor);
+    else
+        StencilLoop<0, Stencil<Conn, EVEN_TET_PARITY>::size>::template visit<L>(x, y, z, size, visitor);
+}
+
+#endif
@@ -0,0 +1,137 @@
+/*
+ * Linear-time statistics of the vertex -> arc (or branch) maps from ct_arcMap()/ct_branchMap().
+ *
+ * One sweep over the map gives every distinct arc an id (open-addressing hash on the
+ * pointer), counts its vertices, and from those counts the log2 size histogram and the
+ * largest arcs follow without touching the map again.
+ */
+
+#ifndef TREE_STATISTICS_H
+#define TREE_STATISTICS_H
+
+#include <vector>
+#include <iostream>
+#include <algorithm>    // std::partial_sort
+#include <cstddef>
+#include <stdint.h>
+
+template <typename T>
+class MapStatistics
+{
+    private:
+        std::vector< T* > table;        // hash slots, NULL = empty
+        std::vector< size_t > table_id; // id of the pointer in each slot
+
+        size_t slot(const T * p) const
+        {
+            uint64_t h = reinterpret_cast<uintptr_t>(p);
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;  // 64 bit finalizer mix
+            h ^= h >> 33;
+            return h & (table.size() - 1);
+        }
+
+        void grow()
+        {
+            std::vector< T* > bigger(table.size() * 2, static_cast<T*>(0));
+            table.swap(bigger);
+            table_id.assign(table.size(), 0);
+            for (size_t i = 0; i < items.size(); ++i) {
+                size_t s = slot(items[i]);
+                while (table[s] != 0) s = (s + 1) & (table.size() - 1);
+                table[s] = items[i];
+                table_id[s] = i;
+            }
+        }
+
+    public:
+        std::vector< T* > items;        // distinct arcs/branches, in first-seen order
+        std::vector< size_t > sizes;    // vertices mapped to each item
+        std::vector< size_t > histogram;    // [k] = items with 2^k <= size < 2^(k+1)
+
+        MapStatistics() : table(1024, static_cast<T*>(0)), table_id(1024, 0) {}
+
+        // id of p, or items.size() if p never occurs in the map
+        size_t find(const T * p) const
+        {
+            size_t s = slot(p);
+            while (table[s] != 0) {
+                if (table[s] == p) return table_id[s];
+                s = (s + 1) & (table.size() - 1);
+            }
+            return items.size();
+        }
+
+        void compute(T * const * map, const size_t n)
+        {
+            T * last = 0;
+            size_t last_id = 0;
+            for (size_t v = 0; v < n; ++v)
+            {
+                T * p = map[v];
+                if (p != last || v == 0) {     // neighbouring vertices mostly share an arc
+                    last = p;
+                    last_id = find(p);
+                    if (last_id == items.size()) {
+                        if (2 * (items.size() + 1) > table.size()) grow();
+                        size_t s = slot(p);
+                        while (table[s] != 0) s = (s + 1) & (table.size() - 1);
+                        table[s] = p;
+                        table_id[s] = last_id;
+                        items.push_back(p);
+                        sizes.push_back(0);
+                    }
+                }
+                sizes[last_id]++;
+            }
+
+            histogram.clear();
+            for (size_t i = 0; i < sizes.size(); ++i) {
+                size_t k = 0;
+                while ((sizes[i] >> (k + 1)) != 0) ++k;
+                if (k >= histogram.size()) histogram.resize(k + 1, 0);
+                histogram[k]++;
+            }
+        }
+
+        // ids of the (at most) k largest items, biggest first
+        std::vector< size_t > largest(size_t k) const
+        {
+            std::vector< size_t > ids(sizes.size());
+            for (size_t i = 0; i < ids.size(); ++i) ids[i] = i;
+            if (k > ids.size()) k = ids.size();
+            std::partial_sort(ids.begin(), ids.begin() + k, ids.end(), BySize(sizes));
+            ids.resize(k);
+            return ids;
+        }
+
+        void print(std::ostream & out, const char * name, const size_t top_k) const
+        {
+            out << "--> Number of distinct " << name << "s: " << items.size() << std::endl;
+            out << "--> Size distribution (vertices per " << name << "):" << std::endl;
+            for (size_t k = 0; k < histogram.size(); ++k) {
+                if (histogram[k] == 0) continue;
+                out << "       [" << (size_t(1) << k) << ", " << (size_t(1) << (k+1)) << "): "
+                    << histogram[k] << std::endl;
+            }
+            std::vector< size_t > top = largest(top_k);
+            out << "--> Largest " << top.size() << " " << name << "s:" << std::endl;
+            for (size_t i = 0; i < top.size(); ++i)
+                out << "       " << items[top[i]] << " : " << sizes[top[i]] << " vertices" << std::endl;
+        }
+
+    private:
+        //functor for sorting ids by descending size
+        class BySize
+        {
+            const std::vector< size_t > & sizes;
+            public:
+            BySize( const std::vector< size_t > & s ) : sizes(s) {}
+            bool operator()(const size_t & a, const size_t & b) const {
+                if (sizes[a] == sizes[b]) return a < b;
+                return sizes[a] > sizes[b];
+            }
+        };
+};
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * Non-owning strided view of a box inside a row-major 3D buffer (a FieldStore field, a
+ * Data<T> array, a slab): a pointer to the box's first cell, its extent, and the strides of
+ * the parent. Taking a sub-box, a slab or a coarser sampling only adjusts those numbers, so
+ * kernels that take a view (DerivedField reductions, PaddedField::load, ...) run on a part of
+ * the grid without anything being copied first.
+ *
+ * index(x, y, z) is the row-major id of a view cell in the parent grid, the id every other
+ * field, core_indices and sink_cell_index use.
+ */
+
+#ifndef VOLUME_VIEW_H
+#define VOLUME_VIEW_H
+
+#include <cstddef>
+#include <assert.h>
+
+#include "Global.h"
+
+template <typename T>
+struct VolumeView
+{
+    T * origin;         // cell (0, 0, 0) of the view
+    long offset;        // its id in the parent grid
+    uint extent[3];
+    long stride[3];     // in cells, x then y then z
+
+    T & operator()(const uint x, const uint y, const uint z) const
+    {
+        return origin[x*stride[0] + y*stride[1] + z*stride[2]];
+    }
+
+    VertexId index(const uint x, const uint y, const uint z) const
+    {
+        return offset + x*stride[0] + y*stride[1] + z*stride[2];
+    }
+
+    size_t size() const { return size_t(extent[0]) * extent[1] * extent[2]; }
+
+    // parent id of the j-th cell of the view, counting x fastest
+    VertexId cellIndex(const size_t j) const
+    {
+        const size_t row = j / extent[0];
+        return index(j - row * extent[0], row % extent[1], row / extent[1]);
+    }
+
+    // x rows are contiguous, so inner loops can stream them
+    bool contiguousRows() const { return stride[0] == 1; }
+
+    // the box [first, first + count) of this view, clipped to it
+    VolumeView subView(const uint first[3], const uint count[3]) const
+    {
+        VolumeView v = *this;
+        long shift = 0;
+        for (int d = 0; d < 3; ++d)
+        {
+            const uint f = first[d] < extent[d] ? first[d] : extent[d];
+            const uint c = count[d] < extent[d] - f ? count[d] : extent[d] - f;
+            shift += long(f) * stride[d];
+            v.extent[d] = c;
+        }
+        v.origin = origin + shift;
+        v.offset = offset + shift;
+        return v;
+    }
+
+    // z planes [z_begin, z_begin + num_z)
+    VolumeView slab(const uint z_begin, const uint num_z) const
+    {
+        const uint first[3] = { 0, 0, z_begin };
+        const uint count[3] = { extent[0], extent[1], num_z };
+        return subView(first, count);
+    }
+
+    // every step-th cell along each axis
+    VolumeView sampled(const uint step) const
+    {
+        assert(step > 0);
+        VolumeView v = *this;
+        for (int d = 0; d < 3; ++d)
+        {
+            v.extent[d] = (extent[d] + step - 1) / step;
+            v.stride[d] = stride[d] * step;
+        }
+        return v;
+    }
+};
+
+// the whole of a row-major buffer of the given size
+template <typename T>
+inline VolumeView<T> gridView(T * values, const uint size[3])
+{
+    VolumeView<T> v;
+    v.origin = values;
+    v.offset = 0;
+    for (int d = 0; d < 3; ++d) v.extent[d] = size[d];
+    v.stride[0] = 1;
+    v.stride[1] = size[0];
+    v.stride[2] = long(size[0]) * size[1];
+    return v;
+}
+
+// the box of half-width radius around cell (x, y, z), clipped to the view
+template <typename T>
+inline VolumeView<T> boxAround(const VolumeView<T> & view, const uint x, const uint y, const uint z,
+                               const uint radius)
+{
+    const uint centre[3] = { x, y, z };
+    uint first[3], count[3];
+    for (int d = 0; d < 3; ++d)
+    {
+        first[d] = centre[d] > radius ? centre[d] - radius : 0;
+        count[d] = centre[d] + radius + 1 - first[d];
+    }
+    return view.subView(first, count);
+}
+
+#endif
@@ -1,9 +1,7 @@
 #include <iostream>
 #include <fstream>
 #include <cstring>
-#include <set>
 #include <vector>
-#include <algorithm> // std::count
 
 extern "C" 
 {
@@ -14,6 +12,8 @@ extern "C"
 
 #include "Data.h"
 #include "Mesh.h"
+#include "BranchTree.hpp"
+#include "TreeStatistics.hpp"
 
 #include <unistd.h>
 
@@ -25,14 +25,14 @@ using std::endl;
 
 
 double value ( size_t v, void * d ) {
-	Mesh * mesh = reinterpret_cast<Mesh*>(d);
+	Mesh<DataType> * mesh = reinterpret_cast<Mesh<DataType>*>(d);
 	return mesh->data[v];
 }
 
 
 size_t neighbors ( size_t v, size_t * nbrs, void * d ) {
-	Mesh * mesh = static_cast<Mesh*>(d);
-	static std::vector<size_t> nbrsBuf;
+	Mesh<DataType> * mesh = static_cast<Mesh<DataType>*>(d);
+	static std::vector<VertexId> nbrsBuf;
 	
 	nbrsBuf.clear();
 	mesh->getNeighbors(v,nbrsBuf);
@@ -44,18 +44,6 @@ size_t neighbors ( size_t v, size_t * nbrs, void * d ) {
 }
 
 
-void outputTree( std::ofstream & out, ctBranch * b ) {
-	out << "(" << b->extremum << ' ' << b->saddle ;
-	
-	for ( ctBranch * c = b->children.head; c != NULL; c = c->nextChild ){
-		out << " ";
-		outputTree( out, c );
-	}
-	
-	out << ")";
-} 
-
-
 int main( int argc, char ** argv ) {
 
 
@@ -65,11 +53,12 @@ int main( int argc, char ** argv ) {
 	//command line parameters
 	char filename[1024] = "";
 	char outfile[1024] = "";
+	char binfile[1024] = "";
 	
 	#if USE_ZLIB
-	char switches[256] = "i:o:";
+	char switches[256] = "i:o:b:";
 	#else
-	char switches[256] = "i:o:";
+	char switches[256] = "i:o:b:";
 	#endif
 
     cout << endl;
@@ -83,6 +72,12 @@ int main( int argc, char ** argv ) {
 				case 'o': {
 					strcpy(outfile,optarg);
                     cout << "Output file: " << outfile << endl;
+                    cout << endl;
+					break;
+				}
+				case 'b': {
+					strcpy(binfile,optarg);
+                    cout << "Binary branch tree file: " << binfile << endl;
                     cout << endl;
 					break;
 				}
@@ -98,6 +93,7 @@ int main( int argc, char ** argv ) {
 		clog << "flags" << endl;
 		clog << "\t -i < filename >  :  filename" << endl;
 		clog << "\t -o < filename >  :  filename" << endl;
+		clog << "\t -b < filename >  :  binary (memory-mappable) branch tree" << endl;
 		clog << endl;
 
 		clog << "Filename must be of the form <name>.<i>x<j>x<k>.<type>" << endl;
@@ -113,7 +109,7 @@ int main( int argc, char ** argv ) {
 	char prefix[1024];
 
 	//Load data
-	Data data;
+	Data<DataType> data;
 	bool compress;
 	if (!data.load( filename, prefix, &compress )) {
 		cerr << "Failed to load data" << std::endl;
@@ -123,14 +119,15 @@ int main( int argc, char ** argv ) {
     cout << endl;
 
 	//Create mesh
-	Mesh mesh(data);
-	std::vector<size_t> totalOrder;
+	Mesh<DataType> mesh(data);
+	std::vector<VertexId> totalOrder;
 	mesh.createGraph( totalOrder ); //this just sorts the vertices according to data.less()
+	std::vector<size_t> ctOrder;
 	
 	//init libtourtre
 	ctContext * ctx = ct_init(
 		data.totalSize, //numVertices
-		&(totalOrder.front()), //totalOrder. Take the address of the front of an stl vector, which is the same as a C array
+		widenOrder( totalOrder, ctOrder ), //totalOrder, as the C array of size_t libtourtre wants
 		&value,
 		&neighbors,
 		&mesh //data for callbacks. The global functions less, value and neighbors are just wrappers which call mesh->getNeighbors, etc
@@ -147,34 +144,41 @@ int main( int argc, char ** argv ) {
     cout << "Getting arc_map..." << endl;
     ctArc ** arc_map = ct_arcMap( ctx );
 
-    std::set<ctArc*> arcset(arc_map, arc_map + data.totalSize);
-    cout << "--> Size of set(arc_map): " <<  arcset.size() << endl;
-    std::vector<ctArc*> arc_vec(arc_map, arc_map + data.totalSize);
-    cout << "--> Size of vector(arc_map): " << arc_vec.size() << endl;
+    MapStatistics<ctArc> arc_stats;
+    arc_stats.compute(arc_map, data.totalSize);
+    arc_stats.print(cout, "arc", 10);
 
     ctArc * mid_value = arc_map[data.totalSize/2-1];
     cout << "--> ctArc pointer near arc_map[] midpoint: " << mid_value << endl;
-    cout << "--> Vertices in associated ctArc: " << std::count(arc_vec.begin(), arc_vec.end(), mid_value) << endl;
-    cout << "... but are vertices sorted by location, or by value now? Need to check ..." << endl;
+    cout << "--> Vertices in associated ctArc: " << arc_stats.sizes[arc_stats.find(mid_value)] << endl;
     cout << endl;
     
     //create branch decomposition
     cout << "Getting branch_map..." << endl;
     ctBranch ** map = ct_branchMap(ctx);
 
-    std::set<ctBranch*> branch_set(map, map + data.totalSize);
-    cout << "--> Size of set(branch_map): " << branch_set.size() << endl;
+    MapStatistics<ctBranch> branch_stats;
+    branch_stats.compute(map, data.totalSize);
+    branch_stats.print(cout, "branch", 10);
     cout << endl;
 
+	//flatten the branch decomposition before the context (which owns it) goes away
+	FlatBranchTree flat;
+	flattenBranchTree( root, map, data, flat );
+
 	ct_cleanup( ctx );
 	
 	//output tree
 	std::ofstream out(outfile,std::ios::out);
 	if (out) {
-		outputTree( out, root);
+		writeBranchText( out, flat );
 	} else {
 		cerr << "couldn't open output file " << outfile << endl;
 	}
+
+	if (binfile[0] != '\0') {
+		writeBranchTree( binfile, flat );
+	}
 	
 }
 
@@ -0,0 +1,279 @@
+/*
+ *  Flat branch decompositions: flattening, binary files, memory-mapping and text export
+ *
+ *  Source Outline:
+ *      - Local consts and funcs
+ *      - Flattening
+ *      - Binary files
+ *      - Text export
+ *      - MappedBranchTree
+ */
+
+#include "BranchTree.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <cstring>      // memcpy, memcmp
+
+#include <fcntl.h>      // open
+#include <unistd.h>     // close
+#include <sys/mman.h>   // mmap
+#include <sys/stat.h>   // fstat
+
+extern "C"
+{
+#include <tourtre.h>
+}
+
+using std::cerr;
+using std::endl;
+using std::vector;
+
+// LOCAL constants and functions
+
+const char branch_magic[8] = { 'C', 'T', 'B', 'R', 'A', 'N', 'C', 'H' };
+const uint32_t branch_version = 1;
+
+// bytes taken by the arrays that follow the header, in file order
+size_t branchPayloadSize(const size_t n)
+{
+    return n * (5*sizeof(uint64_t) + 3*sizeof(uint32_t));
+}
+
+template <typename T>
+void writeArray(std::ofstream & out, const vector<T> & v)
+{
+    if (!v.empty())
+        out.write(reinterpret_cast<const char*>(&v.front()), v.size() * sizeof(T));
+}
+
+template <typename T>
+void readArray(std::ifstream & in, vector<T> & v, const size_t n)
+{
+    v.resize(n);
+    if (n > 0)
+        in.read(reinterpret_cast<char*>(&v.front()), n * sizeof(T));
+}
+
+
+/*
+ *      FLATTENING
+ */
+
+template <typename T>
+void flattenBranchTree(ctBranch * root, ctBranch ** branch_map, Data<T> & data, FlatBranchTree & flat)
+{
+    flat = FlatBranchTree();
+
+    // breadth-first, so every node's children end up next to each other
+    vector< ctBranch* > queue(1, root);
+    vector< void* > saved_data;
+    flat.parent.push_back(NO_BRANCH);
+
+    for (size_t q = 0; q < queue.size(); ++q)
+    {
+        ctBranch * b = queue[q];
+        saved_data.push_back(b->data);
+        b->data = reinterpret_cast<void*>(q);
+
+        flat.extremum.push_back(b->extremum);
+        flat.saddle.push_back(b->saddle);
+        flat.extremum_value.push_back(data[b->extremum]);
+        flat.saddle_value.push_back(data[b->saddle]);
+        flat.first_child.push_back(queue.size());
+
+        uint32_t count = 0;
+        for (ctBranch * c = b->children.head; c != NULL; c = c->nextChild) {
+            queue.push_back(c);
+            flat.parent.push_back(q);
+            count++;
+        }
+        flat.num_children.push_back(count);
+    }
+
+    flat.arc_size.assign(queue.size(), 0);
+    if (branch_map != NULL)
+    {
+        for (VertexId v = 0; v < data.totalSize; v++)
+            flat.arc_size[reinterpret_cast<size_t>(branch_map[v]->data)]++;
+    }
+
+    for (size_t q = 0; q < queue.size(); ++q)
+        queue[q]->data = saved_data[q];
+}
+
+template void flattenBranchTree(ctBranch *, ctBranch **, Data<float> &, FlatBranchTree &);
+template void flattenBranchTree(ctBranch *, ctBranch **, Data<double> &, FlatBranchTree &);
+
+
+/*
+ *      BINARY FILES
+ */
+
+bool writeBranchTree(const std::string filename, const FlatBranchTree & flat)
+{
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+    if (!out) {
+        cerr << "writeBranchTree: couldn't open output file " << filename << endl;
+        return false;
+    }
+
+    BranchFileHeader header;
+    memcpy(header.magic, branch_magic, sizeof(branch_magic));
+    header.version = branch_version;
+    header.num_nodes = flat.numNodes();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    writeArray(out, flat.extremum);
+    writeArray(out, flat.saddle);
+    writeArray(out, flat.extremum_value);
+    writeArray(out, flat.saddle_value);
+    writeArray(out, flat.arc_size);
+    writeArray(out, flat.parent);
+    writeArray(out, flat.first_child);
+    writeArray(out, flat.num_children);
+
+    return out.good();
+}
+
+bool readBranchTree(const std::string filename, FlatBranchTree & flat)
+{
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+    BranchFileHeader header;
+    if (!in || !in.read(reinterpret_cast<char*>(&header), sizeof(header))
+            || memcmp(header.magic, branch_magic, sizeof(branch_magic)) != 0
+            || header.version != branch_version) {
+        cerr << "readBranchTree: " << filename << " is not a branch tree file" << endl;
+        return false;
+    }
+
+    const size_t n = header.num_nodes;
+    readArray(in, flat.extremum, n);
+    readArray(in, flat.saddle, n);
+    readArray(in, flat.extremum_value, n);
+    readArray(in, flat.saddle_value, n);
+    readArray(in, flat.arc_size, n);
+    readArray(in, flat.parent, n);
+    readArray(in, flat.first_child, n);
+    readArray(in, flat.num_children, n);
+
+    return in.good();
+}
+
+
+/*
+ *      TEXT EXPORT
+ */
+
+void writeBranchText(std::ostream & out, ctBranch * root)
+{
+    vector< ctBranch* > open;   // branches whose ")" is still pending
+    ctBranch * b = root;
+
+    for (;;)
+    {
+        out << "(" << b->extremum << ' ' << b->saddle;
+        if (b->children.head != NULL) {
+            open.push_back(b);
+            out << " ";
+            b = b->children.head;
+            continue;
+        }
+
+        out << ")";
+        while (!open.empty() && b->nextChild == NULL) {
+            b = open.back();
+            open.pop_back();
+            out << ")";
+        }
+        if (open.empty()) break;
+
+        out << " ";
+        b = b->nextChild;
+    }
+}
+
+void writeBranchText(std::ostream & out, const FlatBranchTree & flat)
+{
+    // one tree per root; a branch decomposition has one, a dendrogram forest several up front
+    for (uint32_t root = 0; root < flat.numNodes() && flat.parent[root] == NO_BRANCH; ++root)
+    {
+        if (root > 0) out << " ";
+
+        // (node, next child to visit) for every branch whose ")" is still pending
+        vector< uint32_t > open, next;
+        open.push_back(root);
+        next.push_back(0);
+        out << "(" << flat.extremum[root] << ' ' << flat.saddle[root];
+
+        while (!open.empty())
+        {
+            const uint32_t b = open.back();
+            if (next.back() == flat.num_children[b]) {
+                out << ")";
+                open.pop_back();
+                next.pop_back();
+                continue;
+            }
+
+            const uint32_t c = flat.first_child[b] + next.back()++;
+            out << " (" << flat.extremum[c] << ' ' << flat.saddle[c];
+            open.push_back(c);
+            next.push_back(0);
+        }
+    }
+}
+
+
+/*
+ *      MappedBranchTree
+ */
+
+MappedBranchTree::MappedBranchTree(const std::string filename):
+    mapping(0),
+    mapping_size(0),
+    num_nodes(0),
+    extremum(0), saddle(0), extremum_value(0), saddle_value(0),
+    arc_size(0), parent(0), first_child(0), num_children(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "MappedBranchTree: couldn't open " << filename << endl;
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(BranchFileHeader)) {
+        mapping_size = st.st_size;
+        mapping = mmap(0, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) mapping = 0;
+    }
+    close(fd);
+
+    const BranchFileHeader * header = static_cast<const BranchFileHeader*>(mapping);
+    if (mapping == 0
+            || memcmp(header->magic, branch_magic, sizeof(branch_magic)) != 0
+            || header->version != branch_version
+            || mapping_size < sizeof(BranchFileHeader) + branchPayloadSize(header->num_nodes)) {
+        cerr << "MappedBranchTree: " << filename << " is not a branch tree file" << endl;
+        if (mapping != 0) munmap(mapping, mapping_size);
+        mapping = 0;
+        return;
+    }
+
+    num_nodes = header->num_nodes;
+    const char * p = static_cast<const char*>(mapping) + sizeof(BranchFileHeader);
+    extremum = reinterpret_cast<const uint64_t*>(p);        p += num_nodes * sizeof(uint64_t);
+    saddle = reinterpret_cast<const uint64_t*>(p);          p += num_nodes * sizeof(uint64_t);
+    extremum_value = reinterpret_cast<const double*>(p);    p += num_nodes * sizeof(double);
+    saddle_value = reinterpret_cast<const double*>(p);      p += num_nodes * sizeof(double);
+    arc_size = reinterpret_cast<const uint64_t*>(p);        p += num_nodes * sizeof(uint64_t);
+    parent = reinterpret_cast<const uint32_t*>(p);          p += num_nodes * sizeof(uint32_t);
+    first_child = reinterpret_cast<const uint32_t*>(p);     p += num_nodes * sizeof(uint32_t);
+    num_children = reinterpret_cast<const uint32_t*>(p);
+}
+
+MappedBranchTree::~MappedBranchTree()
+{
+    if (mapping != 0) munmap(mapping, mapping_size);
+}
@@ -0,0 +1,269 @@
+/*
+ *  Parallel connected-component labelling of a thresholded field
+ *
+ *  Source Outline:
+ *      - Local funcs
+ *      - labelComponents
+ */
+
+#include "Components.hpp"
+#include "Layout.hpp"
+
+#include <iostream>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using std::vector;
+using std::cerr;
+using std::endl;
+
+// LOCAL functions
+
+// stencil offsets k that point to a lower row-major index
+constexpr bool lowerOffset(const int k)
+{
+    return stencil_offsets[k][2] < 0 ||
+           (stencil_offsets[k][2] == 0 && (stencil_offsets[k][1] < 0 ||
+                                           (stencil_offsets[k][1] == 0 && stencil_offsets[k][0] < 0)));
+}
+
+inline VertexId findRoot(vector< VertexId > & parent, VertexId v)
+{
+    VertexId p = parent[v];
+    while (p != v)
+    {
+        const VertexId grand = parent[p];
+        if (grand != p) parent[v] = grand;     // path halving, no store once v hangs off the root
+        v = grand;
+        p = parent[v];
+    }
+    return v;
+}
+
+// joins neighbour n to the set whose root is root, and returns the root of the union
+inline VertexId linkTo(vector< VertexId > & parent, const VertexId root, const VertexId n,
+                       VertexId & roots)
+{
+    const VertexId r = findRoot(parent, n);
+    if (r == root) return root;
+    --roots;
+    if (r < root)
+    {
+        parent[root] = r;   // the larger root goes under the smaller, so a root is always
+        return r;           // the first cell of its component
+    }
+    parent[r] = root;
+    return root;
+}
+
+// union-find over the cells of z planes [z_begin, z_end), within those planes only; returns the
+// number of sets left
+template <int Conn>
+VertexId labelBlock(const uint size[3], const uint z_begin, const uint z_end,
+                vector< VertexId > & parent)
+{
+    // the lower neighbours as row-major offsets, for cells whose whole stencil is in the block;
+    // when the cell to the left is inside, the ones that are also its neighbours are already in
+    // its set, which leaves 4 of 13 to check at 26 connectivity
+    long offset[13], after_left[13];
+    int num_lower = 0, num_after_left = 0;
+    for (int k = 0; k < Stencil<Conn, EVEN_TET_PARITY>::size; ++k)
+    {
+        if (!lowerOffset(k)) continue;
+        const int * o = stencil_offsets[k];
+        const long linear = o[0] + long(size[0]) * (o[1] + long(size[1]) * o[2]);
+        offset[num_lower++] = linear;
+        const int from_left = (o[0] + 1 != 0) + (o[1] != 0) + (o[2] != 0);
+        const bool left_neighbour = o[0] + 1 <= 1 &&
+                                    (Conn == CONN_6 ? from_left <= 1 :
+                                     Conn == CONN_18 ? from_left <= 2 : true);
+        if (!left_neighbour) after_left[num_after_left++] = linear;     // (the left cell too)
+    }
+
+    VertexId roots = 0;
+    for (uint z = z_begin; z < z_end; ++z)
+        for (uint y = 0; y < size[1]; ++y)
+        {
+            const bool inner_row = z > z_begin && y > 0 && y + 1 < size[1];
+            for (uint x = 0; x < size[0]; ++x)
+            {
+                const VertexId i = RowMajor::index(x, y, z, size);
+                if (parent[i] == NOTHING) continue;
+                ++roots;
+                VertexId root = i;
+                if (inner_row && x > 0 && x + 1 < size[0])
+                {
+                    const bool left_inside = parent[i - 1] != NOTHING;
+                    const long * o = left_inside ? after_left : offset;
+                    const int num = left_inside ? num_after_left : num_lower;
+                    if (left_inside) root = linkTo(parent, root, i - 1, roots);
+                    for (int k = 0; k < num; ++k)
+                    {
+                        const VertexId n = i + o[k];
+                        if (parent[n] != NOTHING) root = linkTo(parent, root, n, roots);
+                    }
+                    continue;
+                }
+                for (int k = 0; k < Stencil<Conn, EVEN_TET_PARITY>::size; ++k)
+                {
+                    if (!lowerOffset(k)) continue;
+                    const uint nx = x + stencil_offsets[k][0];
+                    const uint ny = y + stencil_offsets[k][1];
+                    const uint nz = z + stencil_offsets[k][2];
+                    if (nx >= size[0] || ny >= size[1] || nz < z_begin || nz >= size[2]) continue;
+                    const VertexId n = RowMajor::index(nx, ny, nz, size);
+                    if (parent[n] != NOTHING) root = linkTo(parent, root, n, roots);
+                }
+            }
+        }
+    return roots;
+}
+
+// links plane z_first[b] to the top plane of block b - 1, one less set in a block for every
+// root of it that is linked under another
+template <int Conn>
+void mergePlane(const uint size[3], const vector< uint > & z_first, const int b,
+                vector< VertexId > & parent, vector< VertexId > & roots)
+{
+    const uint z = z_first[b];
+    const VertexId plane = VertexId(size[0]) * size[1];
+    for (uint y = 0; y < size[1]; ++y)
+        for (uint x = 0; x < size[0]; ++x)
+        {
+            const VertexId i = RowMajor::index(x, y, z, size);
+            if (parent[i] == NOTHING) continue;
+            for (int k = 0; k < Stencil<Conn, EVEN_TET_PARITY>::size; ++k)
+            {
+                if (stencil_offsets[k][2] >= 0) continue;
+                const uint nx = x + stencil_offsets[k][0];
+                const uint ny = y + stencil_offsets[k][1];
+                if (nx >= size[0] || ny >= size[1]) continue;
+                const VertexId n = RowMajor::index(nx, ny, z - 1, size);
+                if (parent[n] == NOTHING) continue;
+
+                const VertexId a = findRoot(parent, i);
+                const VertexId r = findRoot(parent, n);
+                if (a == r) continue;
+                const VertexId lower = a < r ? a : r;
+                const VertexId upper = a < r ? r : a;
+                parent[upper] = lower;
+                const int owner = std::upper_bound(z_first.begin(), z_first.end(),
+                                                   uint(upper / plane)) - z_first.begin() - 1;
+                --roots[owner];
+            }
+        }
+}
+
+// labels the blocks in parallel and merges them, leaving the number of roots in each block
+template <int Conn>
+void labelAndMerge(const uint size[3], const vector< uint > & z_first,
+                   vector< VertexId > & parent, vector< VertexId > & roots)
+{
+    const int num_blocks = z_first.size() - 1;
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int b = 0; b < num_blocks; ++b)
+        roots[b] = labelBlock<Conn>(size, z_first[b], z_first[b + 1], parent);
+
+    for (int b = 1; b < num_blocks; ++b)
+        mergePlane<Conn>(size, z_first, b, parent, roots);
+}
+
+/*
+ *      labelComponents
+ */
+
+void labelComponents(const float * values, const uint size[3], const float threshold,
+                     const bool above, const Connectivity connectivity, Components & out)
+{
+    const VertexId n = VertexId(size[0]) * size[1] * size[2];
+    const long num_cells = n;
+    const VertexId plane = VertexId(size[0]) * size[1];
+
+    // every cell inside the threshold starts as its own root, NOTHING marks the rest
+    vector< VertexId > parent(n);
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < num_cells; ++i)
+    {
+        const bool inside = above ? values[i] > threshold : values[i] < threshold;
+        parent[i] = inside ? VertexId(i) : NOTHING;
+    }
+
+    int num_blocks = 1;
+#ifdef _OPENMP
+    num_blocks = omp_get_max_threads();
+#endif
+    if (num_blocks > int(size[2])) num_blocks = size[2];
+    vector< uint > z_first(num_blocks + 1);
+    for (int b = 0; b <= num_blocks; ++b) z_first[b] = uint((size_t(size[2]) * b) / num_blocks);
+
+    vector< VertexId > roots(num_blocks);
+    if (connectivity == CONN_6) labelAndMerge<CONN_6>(size, z_first, parent, roots);
+    else if (connectivity == CONN_18) labelAndMerge<CONN_18>(size, z_first, parent, roots);
+    else if (connectivity == CONN_26) labelAndMerge<CONN_26>(size, z_first, parent, roots);
+    else
+    {
+        cerr << "PROBLEM!!! components need 6, 18 or 26 connectivity" << endl;
+        return;
+    }
+
+    // roots are numbered in raster order, each block from the count of roots before it
+    vector< VertexId > first_id(num_blocks + 1, 0);
+    for (int b = 0; b < num_blocks; ++b) first_id[b + 1] = first_id[b] + roots[b];
+    const VertexId num_components = first_id[num_blocks];
+
+    out.label.resize(n);
+    out.size.assign(num_components, 0);
+    out.first.resize(num_components);
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int b = 0; b < num_blocks; ++b)
+    {
+        VertexId id = first_id[b];
+        for (VertexId i = z_first[b] * plane; i < z_first[b + 1] * plane; ++i)
+        {
+            if (parent[i] != i)
+            {
+                out.label[i] = NOTHING;     // non-root cells are filled in below
+                continue;
+            }
+            out.label[i] = id;
+            out.first[id++] = i;
+        }
+    }
+
+    // a parent is always a lower cell, so one in the same block was labelled just before; only
+    // a parent in an earlier block needs the walk to its root (labelled above)
+    #pragma omp parallel for schedule(static, 1)
+    for (int b = 0; b < num_blocks; ++b)
+    {
+        const VertexId block_begin = z_first[b] * plane;
+        VertexId run_id = NOTHING;
+        VertexId run = 0;       // sizes are added a run of equal labels at a time
+        for (VertexId i = block_begin; i < z_first[b + 1] * plane; ++i)
+        {
+            const VertexId p = parent[i];
+            if (p == NOTHING) continue;
+            VertexId id;
+            if (p == i) id = out.label[i];
+            else
+            {
+                VertexId r = p;
+                if (r < block_begin)
+                    while (parent[r] != r) r = parent[r];
+                id = out.label[r];
+                out.label[i] = id;
+            }
+            if (id != run_id)
+            {
+                if (run > 0) __sync_fetch_and_add(&out.size[run_id], run);
+                run_id = id;
+                run = 0;
+            }
+            ++run;
+        }
+        if (run > 0) __sync_fetch_and_add(&out.size[run_id], run);
+    }
+}
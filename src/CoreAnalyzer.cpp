@@ -15,14 +15,29 @@
 #include "Sink.hpp"
 #include "Mesh.h"
 #include "Data.h"
-
-//#include <fstream>
+#include "MPIJoinTree.hpp"
+#include "Minima.hpp"
+#include "QuantizedKeys.hpp"
+#include "LabelVolume.hpp"
+#include "LayoutBenchmark.hpp"
+#include "BoundMass.hpp"
+#include "MassProfile.hpp"
+#include "RegionStats.hpp"
+#include "Components.hpp"
+#include "Dendrogram.hpp"
+#include "BranchTree.hpp"
+#include "RadialProfile.hpp"
+#include "Projection.hpp"
+
+#include <fstream>
 //#include <cstring>
 #include <algorithm>    // std::count, std::equal, std::max/min_element
 #include <iterator>     // std::distance
 #include <set>
+#include <sstream>
 #include <limits>
 #include <math.h>       // sqrt()
+#include <stdint.h>
 //#include <time.h>
 //#include <unistd.h>
 
@@ -56,22 +71,99 @@ float sink_grav(const vector<float>& pos, const Sink& sink)
     return G*sink.getMass() / vec_distance(pos, sink.getPosition());
 }
 
+void loadFieldFromHDF ( const FieldId f, float * values, float * bounds, void * d ) {
+	CoreAnalyzer * analyzer = static_cast<CoreAnalyzer*>(d);
+	analyzer->loadField(f, values, bounds);
+}
+
+// the fields each analysis stage reads, required (and so prefetched) when it starts
+const FieldMask GPOT_FIELDS = fieldBit(FIELD_GPOT);
+const FieldMask ARC_FIELDS = fieldBit(FIELD_GPOT) | fieldBit(FIELD_DENS)
+                           | fieldBit(FIELD_VELX) | fieldBit(FIELD_VELY) | fieldBit(FIELD_VELZ);
+const FieldMask BOUND_MASS_FIELDS = ALL_FIELDS;
+
+void loadGpotSlab ( uint z_begin, uint num_z, float * slab, void * d ) {
+	CoreAnalyzer * analyzer = static_cast<CoreAnalyzer*>(d);
+	analyzer->loadGravitySlab(z_begin, num_z, slab);
+}
+
+#ifdef USE_MPI
+struct MPISlabSource
+{
+	CoreAnalyzer * analyzer;
+	MPI_Comm comm;
+};
+
+void loadGpotSlabMPI ( uint z_begin, uint num_z, float * slab, void * d ) {
+	MPISlabSource * source = static_cast<MPISlabSource*>(d);
+	source->analyzer->loadGravitySlab(z_begin, num_z, slab, source->comm);
+}
+#endif
+
+// callback data for the libtourtre sweep: the mesh (of gpot or its sort keys, in layout L),
+// plus the (row-major) fields integrated per arc
+template <typename T, typename L>
+struct SweepData
+{
+	Mesh<T, L> * mesh;
+	double cell_vol;
+	const float * dens;
+	const float * velx;
+	const float * vely;
+	const float * velz;
+	const float * gpot;
+	vector< ArcIntegrals* > integrals;	// every ArcIntegrals handed out, for cleanup
+};
+
+template <typename T, typename L>
 double value ( size_t v, void * d ) {
-	Mesh * mesh = reinterpret_cast<Mesh*>(d);
-	return mesh->data[v];
+	SweepData<T, L> * sweep = static_cast<SweepData<T, L>*>(d);
+	return sweep->mesh->data[v];
 }
 
+// neighbours under connectivity Conn, written straight into libtourtre's buffer
+template <typename T, typename L, int Conn>
 size_t neighbors ( size_t v, size_t * nbrs, void * d ) {
-	Mesh * mesh = static_cast<Mesh*>(d);
-	static vector<size_t> nbrsBuf;
-	
-	nbrsBuf.clear();
-	mesh->getNeighbors(v,nbrsBuf);
-	
-	for (uint i = 0; i < nbrsBuf.size(); i++) {
-		nbrs[i] = nbrsBuf[i]; 
+	SweepData<T, L> * sweep = static_cast<SweepData<T, L>*>(d);
+	return sweep->mesh->template neighborsOf<Conn>(v, nbrs);
+}
+
+// called by the sweep as each vertex is assigned to its arc
+template <typename T, typename L>
+void accumulateVertex ( size_t v, ctArc * a, void * d ) {
+	SweepData<T, L> * sweep = static_cast<SweepData<T, L>*>(d);
+	ArcIntegrals * arc = static_cast<ArcIntegrals*>(a->data);
+	if (arc == NULL) {
+		arc = new ArcIntegrals();
+		sweep->integrals.push_back(arc);
+		a->data = arc;
+	}
+	const VertexId r = sweep->mesh->data.toRowMajor(v);
+	arc->addCell(sweep->cell_vol, sweep->dens[r],
+	             sweep->velx[r], sweep->vely[r], sweep->velz[r], sweep->gpot[r]);
+}
+
+// called when arc b is absorbed into arc a
+template <typename T, typename L>
+void mergeArcs ( ctArc * a, ctArc * b, void * d ) {
+	SweepData<T, L> * sweep = static_cast<SweepData<T, L>*>(d);
+	ArcIntegrals * absorbed = static_cast<ArcIntegrals*>(b->data);
+	if (absorbed == NULL) return;
+	if (a->data == NULL) {
+		a->data = new ArcIntegrals();
+		sweep->integrals.push_back(static_cast<ArcIntegrals*>(a->data));
 	}
-	return nbrsBuf.size();
+	static_cast<ArcIntegrals*>(a->data)->merge(*absorbed);
+	*absorbed = ArcIntegrals();
+	b->data = NULL;
+}
+
+// the arc's upper and lower vertices, as row-major ids whatever the layout of data
+template <typename D>
+void setArcEnds ( ctArc * a, D & data ) {
+	ArcIntegrals * arc = static_cast<ArcIntegrals*>(a->data);
+	arc->hi = data.toRowMajor(a->hi->i);
+	arc->lo = data.toRowMajor(a->lo->i);
 }
 
 // CONSTRUCTOR
@@ -81,10 +173,13 @@ CoreAnalyzer::CoreAnalyzer(const std::string base_dir,
                            const int id):
     data_directory(base_dir),
     sink_id(id),
-    sinks_mapped(false)
+    sinks_mapped(false),
+    key_bits(0),
+    layout(ROW_MAJOR_LAYOUT),
+    connectivity(CONN_TET),
+    unbind_iterations(1)
 {
     sinks = sink_rec.getMySinks();   // does this work?
-    setVariableNames();
 }
 
 
@@ -96,76 +191,64 @@ void CoreAnalyzer::loadAllData()
 {
     cout << "Called CoreAnalyzer::loadAllData()" << endl << endl;
 
-    // LOAD MINMAX_XYZ 
+    openData(0);
+    fields.require(ALL_FIELDS);
 
-    vector< std::string >::const_iterator it;
+    check_bounds();
+    check_data_minmax();
+}
 
-    n_elems = 512*512*512; // should be more general in the future
-    pixel_size = 512;
+void CoreAnalyzer::openData(const size_t field_budget)
+{
+    cout << "Called CoreAnalyzer::openData()" << endl << endl;
 
-    for (it = var_names.begin(); it != var_names.end(); ++it)
-    {
-        std::string file_var_name = (*it).substr(0,4);
-        std::string filename = data_directory + "extracted_" + file_var_name;
+    // LOAD MINMAX_XYZ, the fields themselves are read when a stage first needs them
+    unsigned int size[3];
+    readGridGeometry(size);
 
-        vector<float> temp_var(n_elems, 0.0);
-        vector<float> temp_bounds(6, 0.0);
-        // pass the vector as C-style array
-        loadArrayFromHDF(&temp_var[0], filename, *it);
-        data_map[*it] = temp_var;
+    fields.setLoader(&loadFieldFromHDF, this, size);
+    fields.setBudget(field_budget);
+}
 
-        loadArrayFromHDF(&temp_bounds[0], filename, "minmax_xyz");
-        bounds_map[*it] = temp_bounds;
+void CoreAnalyzer::loadField(const FieldId f, float * values, float * bounds)
+{
+    const FieldInfo & info = fieldInfo(f);
+    std::string filename = data_directory + "extracted_" + info.file;
 
-        cout << "CoreAnalyzer::loadAllData --> inserted " << *it << " vector in data_map";
-        cout << endl << "  MinMax_xyz = ";
-        print_container(temp_bounds);
-        cout << endl << endl;
+    loadArrayFromHDF(values, filename, info.name);
+    loadArrayFromHDF(bounds, filename, "minmax_xyz");
+    if (f == FIELD_GPOT && sinks_mapped)
+    {
+        addSinkGravity(values, 0, n_elems);     // first load, or reloaded after an eviction
+        cout << "The closest cell to the sink particle is index: " << sink_cell_index << endl;
+        cout << "       with distance: " << min_distance << endl;
     }
 
-    check_bounds_map();
-    check_data_minmax();
+    if (! std::equal(bounds, bounds + 6, minmax_xyz.begin()))
+    {
+        cerr << "PROBLEM!!! --> unequal bounds for: gpot and " << info.name << endl;
+    }
+
+    cout << "CoreAnalyzer::loadField --> loaded " << info.name << " (" << info.units << ")";
+    cout << endl << "  MinMax_xyz = ";
+    print_container(vector<float>(bounds, bounds + 6));
+    cout << endl << endl;
 }
 
 void CoreAnalyzer::mapSinkGravity()
 {
     cout << "CoreAnalyzer::mapSinkGravity() called..." << endl;
 
-    unsigned int i(0);      // to keep track of flat index
-    // iterate over gpot cells
-    vector<float>::iterator gpot_it;
-    for (gpot_it = data_map["gpot"].begin(); gpot_it != data_map["gpot"].end(); ++gpot_it)
-    {
-        vector<float> cell_pos = index_to_position(i);
-
-        // iterate over sink particles
-        vector<Sink>::const_iterator sink_it;
-        int sink_counter = 0;
-        for (sink_it = sinks.begin(); sink_it != sinks.end(); ++sink_it)
-        {
-            float dist_to_sink = vec_distance(cell_pos, sink_it->getPosition());
-
-            if (dist_to_sink == 0.0){
-                cout << "THERE WAS A DISTANCE = 0!!!" << endl;
-                dist_to_sink = 0.01;
-            }
-
-
-            if ((sink_counter == sink_id) && (dist_to_sink < min_distance))
-            {
-                min_distance = dist_to_sink;
-                sink_cell_index = i;
-            }
+    // from here on loadField() adds the sinks whenever gpot is read, so a stage that never
+    // requires gpot never loads it; only a gpot already in memory is updated now
+    sinks_mapped = true;
+    if (fields.size(FIELD_GPOT) == 0) return;
 
-            *gpot_it -= G*sink_it->getMass() / dist_to_sink;
+    addSinkGravity(fields.ptr(FIELD_GPOT), 0, fields.size(FIELD_GPOT));
+    fields.updateMinMax(FIELD_GPOT);
 
-            sink_counter++;
-        }
-        i++;
-    }
     cout << "The closest cell to the sink particle is index: " << sink_cell_index << endl;
     cout << "       with distance: " << min_distance << endl << endl;
-    sinks_mapped = true;
 }
 
 
@@ -179,55 +262,212 @@ void CoreAnalyzer::findCoreRegion()
         return;
     }
 
-    Data data;
-    data.loadFromVector(data_map["gpot"], data_map["gpot"].size() ); 
-
-    cout << "Number of data points: " << data.totalSize << endl;
+    fields.require(ARC_FIELDS);     // gpot, plus what the arcs integrate
+    float * gpot = fields.ptr(FIELD_GPOT);
+    cout << "Number of data points: " << n_elems << endl;
     cout << endl;
 
-    //Create mesh
-    Mesh mesh(data);
-    std::vector<size_t> totalOrder;
-    mesh.createGraph( totalOrder ); //this just sorts the vertices according to data.less()
+    std::vector<VertexId> totalOrder;
+    if (key_bits != 0 && layout != ROW_MAJOR_LAYOUT)
+        cout << "NOTE: sort keys are row-major, ignoring the field layout" << endl;
 
-    //init libtourtre
-    ctContext * ctx = ct_init(
-        data.totalSize, //numVertices
-        &(totalOrder.front()), // c array style
-        &value, // callback funcs
-        &neighbors,
-        &mesh //data for callbacks.
-    );
-    cout << "Initialized ctContext" << endl;
+    if (key_bits == 32)
+    {
+        vector<uint32_t> keys;
+        makeFloatKeys(gpot, n_elems, keys);
+        radixSortOrder(keys, totalOrder);
+        cout << "32 bit keys: " << countAddedTies(gpot, keys, totalOrder) << " ties added" << endl;
+
+        Data<uint32_t> data;
+        data.wrap(&keys[0], pixel_size, pixel_size, pixel_size);
+        sweepCoreRegion(data, totalOrder);
+    }
+    else if (key_bits == 16)
+    {
+        vector<uint16_t> keys;
+        makeLinearKeys(gpot, n_elems, keys);
+        radixSortOrder(keys, totalOrder);
+        cout << "16 bit keys: " << countAddedTies(gpot, keys, totalOrder) << " ties added" << endl;
+
+        Data<uint16_t> data;
+        data.wrap(&keys[0], pixel_size, pixel_size, pixel_size);
+        sweepCoreRegion(data, totalOrder);
+    }
+    else if (layout == BRICK_LAYOUT)
+    {
+        Data<float, Brick> data;    // reordered copy of gpot
+        data.loadFromArray(gpot, pixel_size, pixel_size, pixel_size);
 
-    //create contour tree
-    ct_sweepAndMerge( ctx );
+        Mesh<float, Brick> mesh(data);
+        mesh.createGraph( totalOrder );
+        sweepCoreRegion(data, totalOrder);
+    }
+    else if (layout == MORTON_LAYOUT)
+    {
+        Data<float, Morton> data;   // reordered copy of gpot
+        data.loadFromArray(gpot, pixel_size, pixel_size, pixel_size);
 
-    ctBranch * root = ct_decompose( ctx );
+        Mesh<float, Morton> mesh(data);
+        mesh.createGraph( totalOrder );
+        sweepCoreRegion(data, totalOrder);
+    }
+    else
+    {
+        Data<float> data;   // gpot is sorted and swept in place, no double copy
+        data.wrap(gpot, pixel_size, pixel_size, pixel_size);
 
-    // ARC MAPPING STUFF
-    cout << "Getting arc_map..." << endl;
-    ctArc ** arc_map = ct_arcMap( ctx );
-    vector<ctArc*> arc_vec(arc_map, arc_map + data.totalSize);
-    cout << "size of arc_vec = " << arc_vec.size() << endl;
+        Mesh<float> mesh(data);
+        mesh.createGraph( totalOrder ); //this just sorts the vertices according to data.less()
+        sweepCoreRegion(data, totalOrder);
+    }
+}
 
-    ctArc * sink_arcptr = arc_vec[sink_cell_index];
+void CoreAnalyzer::setKeyBits(const int bits)
+{
+    if (bits != 0 && bits != 16 && bits != 32)
+    {
+        cerr << "PROBLEM!!! sort keys must be 16 or 32 bits (or 0 for none), not " << bits << endl;
+        return;
+    }
+    key_bits = bits;
+}
 
-    vector<ctArc*>::const_iterator arc_it;
-    unsigned int i(0);
-    for (arc_it = arc_vec.begin(); arc_it != arc_vec.end(); ++arc_it)
+void CoreAnalyzer::setLayout(const std::string name)
+{
+    const unsigned int edge = pixel_size;
+    const unsigned int size[3] = { edge, edge, edge };
+    if (name == "row")
+        layout = ROW_MAJOR_LAYOUT;
+    else if (name == "brick" && Brick::fits(size))
+        layout = BRICK_LAYOUT;
+    else if (name == "morton" && Morton::fits(size))
+        layout = MORTON_LAYOUT;
+    else
+        cerr << "PROBLEM!!! unknown layout, or it doesn't fit the grid: " << name << endl;
+}
+
+void CoreAnalyzer::setConnectivity(const std::string name)
+{
+    if (name == "tet")
+        connectivity = CONN_TET;
+    else if (name == "6")
+        connectivity = CONN_6;
+    else if (name == "18")
+        connectivity = CONN_18;
+    else if (name == "26")
+        connectivity = CONN_26;
+    else
+        cerr << "PROBLEM!!! unknown connectivity: " << name << endl;
+}
+
+void CoreAnalyzer::benchmarkLayouts()
+{
+    const unsigned int edge = pixel_size;
+    const unsigned int size[3] = { edge, edge, edge };
+    fields.require(GPOT_FIELDS);
+    benchmarkNeighborGather(fields.ptr(FIELD_GPOT), size, cout);
+}
+
+// one row per contour tree arc, i.e. the core mass function of the whole checkpoint, keyed by the
+// arc's upper and lower vertices (row-major cell ids)
+void CoreAnalyzer::writeArcIntegrals(const std::string filename) const
+{
+    std::ofstream out(filename.c_str(), std::ios::out);
+    if (!out)
     {
-        if (*arc_it == sink_arcptr) // if cell is associated with same arc as sink
-        {
-            core_indices.push_back(i);
-        }
-        i++;
+        cerr << "PROBLEM!!! couldn't open output file " << filename << endl;
+        return;
     }
-    cout << "core_indices have been set... there are " << core_indices.size() << " cells" << endl;
 
-    ct_cleanup( ctx );
+    out << "# hi_vertex lo_vertex cells volume(cm^3) mass(Msol) CoM_velx CoM_vely CoM_velz gpot_min gpot_max"
+        << endl;
+    vector< ArcIntegrals >::const_iterator it;
+    for (it = arc_integrals.begin(); it != arc_integrals.end(); ++it)
+    {
+        const double m = it->mass;
+        out << it->hi << " " << it->lo << " " << it->num_cells << " " << it->volume << " " << m / 2.0e33 << " "
+            << (m > 0.0 ? it->px / m : 0.0) << " " << (m > 0.0 ? it->py / m : 0.0) << " "
+            << (m > 0.0 ? it->pz / m : 0.0) << " "
+            << it->gpot_min << " " << it->gpot_max << endl;
+    }
+    cout << "CoreAnalyzer::writeArcIntegrals() --> wrote " << arc_integrals.size()
+         << " arcs to " << filename << endl;
+}
+
+void CoreAnalyzer::writeThresholdProfile(const std::string filename, const unsigned int num_levels)
+{
+    if (core_indices.empty())
+    {
+        cerr << "PROBLEM!!! Attempting to write a threshold profile before finding the core." << endl;
+        return;
+    }
+    std::ofstream out(filename.c_str(), std::ios::out);
+    if (!out)
+    {
+        cerr << "PROBLEM!!! couldn't open output file " << filename << endl;
+        return;
+    }
+
+    fields.require(BOUND_MASS_FIELDS);
+    Data<float> data;
+    data.wrap(fields.ptr(FIELD_GPOT), pixel_size, pixel_size, pixel_size);
+    vector<VertexId> sorted(core_indices);
+    std::sort(sorted.begin(), sorted.end(),
+              [&data](const VertexId a, const VertexId b) { return data.less(a, b); });
+
+    vector<ProfileRow> rows;
+    thresholdProfile(CellEnergetics(fields, cell_vol), sorted, num_levels, rows);
+    writeProfile(rows, out);
+    cout << "CoreAnalyzer::writeThresholdProfile() --> wrote " << rows.size()
+         << " levels to " << filename << endl;
 }
 
+void CoreAnalyzer::findJoinTreeOutOfCore(const size_t memory_budget)
+{
+    cout << "CoreAnalyzer::findJoinTreeOutOfCore() called... " << endl;
+
+    // only the grid geometry is read up front, gpot itself is streamed in slabs
+    unsigned int size[3];
+    readGridGeometry(size);
+
+    OutOfCoreJoinTree builder(size, memory_budget, &loadGpotSlab, this);
+    builder.build(gpot_join_tree);
+
+    cout << "The closest cell to the sink particle is index: " << sink_cell_index << endl;
+    cout << "       with distance: " << min_distance << endl << endl;
+}
+
+void CoreAnalyzer::loadGravitySlab(const unsigned int z_begin, const unsigned int num_z, float * slab)
+{
+    const unsigned int plane_size = pixel_size * pixel_size;
+    loadSlabFromHDF(slab, data_directory + "extracted_gpot", "gpot", z_begin, num_z);
+    addSinkGravity(slab, z_begin * plane_size, num_z * plane_size);
+}
+
+#ifdef USE_MPI
+void CoreAnalyzer::findJoinTreeMPI(MPI_Comm comm, const bool verify)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (rank == 0) cout << "CoreAnalyzer::findJoinTreeMPI() called... " << endl;
+
+    unsigned int size[3];
+    readGridGeometry(size);
+
+    MPISlabSource source = { this, comm };
+    MPIJoinTree builder(size, comm, &loadGpotSlabMPI, &source);
+    builder.build(gpot_join_tree, verify);
+}
+
+void CoreAnalyzer::loadGravitySlab(const unsigned int z_begin, const unsigned int num_z, float * slab,
+                                   MPI_Comm comm)
+{
+    const unsigned int plane_size = pixel_size * pixel_size;
+    loadSlabFromHDF(slab, data_directory + "extracted_gpot", "gpot", z_begin, num_z, comm);
+    addSinkGravity(slab, z_begin * plane_size, num_z * plane_size);
+}
+#endif
+
 void CoreAnalyzer::altFindCoreRegion()
 {
     cout << "CoreAnalyzer::altFindCoreRegion() called... " << endl;
@@ -237,130 +477,474 @@ void CoreAnalyzer::altFindCoreRegion()
         cerr << "PROBLEM!!! Attempting to find core region before mapping sink grav." << endl;
         return;
     }
-    Data data;
-    data.loadFromVector(data_map["gpot"], data_map["gpot"].size() ); 
+    fields.require(GPOT_FIELDS);
+    Data<float> data;
+    data.wrap(fields.ptr(FIELD_GPOT), pixel_size, pixel_size, pixel_size);
 
     cout << "Number of data points: " << data.totalSize << endl;
     cout << endl;
 
     // Create mesh -- Should maybe smooth the data first? Could put code in Data or Mesh.
-    Mesh mesh(data);
-    std::vector<size_t> totalOrder;
+    Mesh<float> mesh(data);
+    std::vector<VertexId> totalOrder;
     mesh.createGraph( totalOrder ); // sorts the vertices according to data.less()
 
-    std::vector<size_t> holder (data.totalSize, 0);    // placeholder
-    holder[sink_cell_index] = 2;    // "key" for sink region
+    // 2 bits per cell: unvisited = 0, 'outside' = 1, 'sink' = 2
+    LabelVolume<2> holder (data.totalSize, 0);
+    holder.set(sink_cell_index, 2);    // "key" for sink region
     
-    std::vector<size_t>::const_iterator it;
+    std::vector<VertexId> neighbs;
+    std::vector<VertexId>::const_iterator it;
     for (it = totalOrder.begin(); it != totalOrder.end(); ++it)
     {
-        std::vector<size_t> neighbs;
+        if (holder.get(*it) == 2) continue;    // the sink cell itself, keep its key
+
+        neighbs.clear();
         mesh.getNeighbors18(*it, neighbs);
-        std::vector<size_t> hold_nbs;
-        std::vector<size_t>::const_iterator hit;
-        for (hit = neighbs.begin(); hit != neighbs.end() ; ++hit)
-        {
-            hold_nbs.push_back(holder[*hit]);
-        }
+        unsigned int hold_nbs = holder.labelsOf(&neighbs[0], neighbs.size());
         
         // if not neighboring current sink region, mark as 'outside' = 1
-        bool sink_neighbor = (std::find(hold_nbs.begin(), hold_nbs.end(), 2) != hold_nbs.end());
+        bool sink_neighbor = (hold_nbs >> 2) & 1;
         if (!sink_neighbor){
-            holder[*it] = 1;
+            holder.set(*it, 1);
             continue;
         }
 
         // if neighboring sink region but not the 'outside' region, mark as 'sink' = 2
-        bool outside_neighbor = (std::find(hold_nbs.begin(), hold_nbs.end(), 1) != hold_nbs.end());
+        bool outside_neighbor = (hold_nbs >> 1) & 1;
         if (!outside_neighbor){ // and sink_neighbor implicitly
-            holder[*it] = 2;
+            holder.set(*it, 2);
             continue;
         }
 
         // if it neighbors both regions, mark as 'sink'(?) and we're done
-        holder[*it] = 2;
+        holder.set(*it, 2);
         break;
     }
     
-    for (it = holder.begin(); it != holder.end(); ++it)
+    holder.indicesOf(2, core_indices);
+    cout << "core_indices have been set... there are " << core_indices.size() << " cells" << endl;
+}
+
+
+void CoreAnalyzer::findAllCores(const float persistence_threshold, const std::string catalogue_file,
+                                const unsigned int radius)
+{
+    cout << "CoreAnalyzer::findAllCores() called... " << endl;
+
+    if (!sinks_mapped)
     {
-        if (*it == 2)
-            core_indices.push_back(*it);
+        cerr << "PROBLEM!!! Attempting to find cores before mapping sink grav." << endl;
+        return;
     }
 
-}
+    fields.require(BOUND_MASS_FIELDS);  // gpot for the basins, the rest for the masses
+    const VolumeView<float> grid = fields.view(FIELD_GPOT);
 
+    // the whole grid, or the box around the sink; basin ids are row-major within it
+    VolumeView<float> search = grid;
+    if (radius > 0)
+    {
+        uint x, y, z;
+        RowMajor::coords(sink_cell_index, grid.extent, x, y, z);
+        search = boxAround(grid, x, y, z, radius);
 
+        // a corner with even x + y + z keeps the box's tetrahedra those of the whole grid
+        RowMajor::coords(search.offset, grid.extent, x, y, z);
+        if ((x + y + z) % 2 != 0 && (x > 0 || search.extent[0] > 1))
+        {
+            const uint first[3] = { x > 0 ? x - 1 : x + 1, y, z };
+            const uint count[3] = { x > 0 ? search.extent[0] + 1 : search.extent[0] - 1,
+                                    search.extent[1], search.extent[2] };
+            search = grid.subView(first, count);
+        }
+        cout << "Box of " << search.extent[0] << "x" << search.extent[1] << "x" << search.extent[2]
+             << " cells around the sink" << endl;
+    }
 
-float CoreAnalyzer::calculateBoundMass ()
-{
-    double core_CoM_velx(0.0), core_CoM_vely(0.0), core_CoM_velz(0.0);
-    double core_region_mass(0.0), core_px(0.0), core_py(0.0), core_pz(0.0);
-    double bound_core_mass(0.0);
-    double reference_gpot(-std::numeric_limits<double>::max());
-    cout << "minimum double value = " << reference_gpot << endl;
-    cout << "cell_vol = " << cell_vol << endl;
-    unsigned int num_bound_cells(0);
+    // stencil passes run on a copy with a +inf ghost layer, free of bounds checks
+    PaddedField<float> padded_gpot;
+    padded_gpot.load(search);
 
-    vector<unsigned int>::const_iterator it;
-    // find CoM
-    for (it = core_indices.begin(); it != core_indices.end(); ++it)
+    // the sweep order, over the gpot itself or a contiguous copy of the box
+    vector<float> box_gpot;
+    Data<float> data;
+    if (radius == 0)
+        data.wrap(search.origin, search.extent[0], search.extent[1], search.extent[2]);
+    else
+    {
+        box_gpot.resize(search.size());
+        for (VertexId j = 0; j < box_gpot.size(); ++j) box_gpot[j] = padded_gpot.at(j);
+        data.wrap(&box_gpot[0], search.extent[0], search.extent[1], search.extent[2]);
+    }
+    Mesh<float> mesh(data);
+    std::vector<VertexId> totalOrder;
+    mesh.createGraph( totalOrder ); // one sort, shared by every core
+
+    vector<VertexId> minima;
+    findLocalMinima(padded_gpot, minima);
+    Basins basins;
+    computeBasins(padded_gpot, totalOrder, minima, basins);
+
+    // persistent minima become cores, the rest hand their cells to the basin that absorbed them
+    vector<VertexId> core_of(basins.numMinima(), NOTHING);
+    vector<VertexId> core_minimum;
+    for (VertexId m = 0; m < basins.numMinima(); ++m)
     {
-        double cell_mass = cell_vol*data_map["dens_pp"][*it];
-        core_px += cell_mass*data_map["velx_pp"][*it];
-        core_py += cell_mass*data_map["vely_pp"][*it];
-        core_pz += cell_mass*data_map["velz_pp"][*it];
-        core_region_mass += cell_mass;
+        if (basins.survivor(m, persistence_threshold) == m)
+        {
+            core_of[m] = core_minimum.size();
+            core_minimum.push_back(m);
+        }
+    }
+    for (VertexId m = 0; m < basins.numMinima(); ++m)
+        core_of[m] = core_of[basins.survivor(m, persistence_threshold)];
+
+    const VertexId num_cores = core_minimum.size();
+    cout << num_cores << " of " << basins.numMinima() << " minima have persistence >= "
+         << persistence_threshold << endl;
+
+    // the root (the minimum that never merges) would own every cell swept after the last
+    // saddle, most of the grid: cut it at the highest saddle of the other cores instead, or of
+    // any other minimum if it is the only core
+    double root_cap = -std::numeric_limits<double>::max();
+    for (VertexId c = 0; c < num_cores; ++c)
+        if (basins.merged_into[core_minimum[c]] != NOTHING)
+            root_cap = std::max(root_cap, basins.saddle[core_minimum[c]]);
+    for (VertexId m = 0; m < basins.numMinima() && num_cores == 1; ++m)
+        if (basins.merged_into[m] != NOTHING)
+            root_cap = std::max(root_cap, basins.saddle[m]);
+    if (root_cap == -std::numeric_limits<double>::max())
+    {
+        cout << "a single minimum, its core is the whole grid" << endl;
+        root_cap = std::numeric_limits<double>::max();
+    }
 
-        if (data_map["gpot"][*it] > reference_gpot)
+    // every grid cell labelled with its core, num_cores for the root's cells above the cap and
+    // for cells outside the box
+    vector<VertexId> core_label(n_elems, num_cores);
+    for (VertexId j = 0; j < search.size(); ++j)
+    {
+        const VertexId m = basins.label[j];
+        if (basins.merged_into[core_minimum[core_of[m]]] == NOTHING && data[j] > root_cap)
+            continue;
+        core_label[search.cellIndex(j)] = core_of[m];
+    }
+    vector<VertexId>().swap(basins.label);
+
+    // pass 1: moments of every core at once, then their CoM, reference (max) gpot, ...
+    const CellEnergetics cells(fields, cell_vol);
+    const unsigned int size[3] = { grid.extent[0], grid.extent[1], grid.extent[2] };
+    const double origin[3] = { minmax_xyz[0], minmax_xyz[2], minmax_xyz[4] };
+    vector<RegionMoments> moments;
+    reduceRegions(cells, size, &core_label[0], num_cores, moments);
+    vector<RegionStats> region(num_cores);
+    for (VertexId c = 0; c < num_cores; ++c)
+        regionStats(moments[c], size, cell_size, origin, cell_vol, region[c]);
+
+    // pass 2: cell energies relative to each core's CoM and reference gpot
+    vector<double> bound_mass(num_cores, 0.0);
+    vector<VertexId> num_bound(num_cores, 0);
+    for (VertexId i = 0; i < n_elems; ++i)
+    {
+        const VertexId c = core_label[i];
+        if (c == num_cores) continue;
+        const RegionStats & r = region[c];
+        BoundMass reference;
+        for (int d = 0; d < 3; ++d) reference.com_vel[d] = r.com_vel[d];
+        reference.reference_gpot = r.gpot_max;
+        double Ekin, Etherm, Egrav;
+        cells.energies(i, reference, Ekin, Etherm, Egrav);
+        if (Ekin + Etherm + Egrav < 0.0)
         {
-           // reference_gpot was initialized to smallest possible float
-           reference_gpot = data_map["gpot"][*it]; 
+            bound_mass[c] += cells.mass(i);
+            ++num_bound[c];
         }
-            
     }
-    cout << "Reference (max in core region) gpot: " << reference_gpot << endl;
 
-    core_CoM_velx = core_px / core_region_mass;
-    core_CoM_vely = core_py / core_region_mass;
-    core_CoM_velz = core_pz / core_region_mass;
+    // sinks sitting in each core, to tell prestellar cores from protostellar ones
+    vector<unsigned int> num_sinks(num_cores, 0);
+    vector<Sink>::const_iterator sink_it;
+    for (sink_it = sinks.begin(); sink_it != sinks.end(); ++sink_it)
+    {
+        unsigned int i = position_to_index(sink_it->getPosition());
+        if (core_label[i] < num_cores) num_sinks[core_label[i]]++;
+    }
 
-    // Calculate cell energies and check for those < 0
-    for (it = core_indices.begin(); it != core_indices.end(); ++it)
+    std::ofstream out(catalogue_file.c_str(), std::ios::out);
+    if (!out)
     {
-        double vx_rel, vy_rel, vz_rel, Etherm, Ekin, Egrav, Etotal;
+        cerr << "PROBLEM!!! couldn't open output file " << catalogue_file << endl;
+        return;
+    }
+    out << "# persistence threshold (erg/g): " << persistence_threshold << endl;
+    out << "# the root core (it never merges) is cut at its saddle_gpot, where the last other core joins it"
+        << endl;
+    out << "# core min_index x y z gpot_min saddle_gpot persistence cells region_mass(Msol)"
+        << " bound_cells bound_mass(Msol) sinks CoM_velx CoM_vely CoM_velz sigma_v(cm/s)"
+        << " L(g cm^2/s) virial_ratio" << endl;
+    for (VertexId c = 0; c < num_cores; ++c)
+    {
+        const VertexId m = core_minimum[c];
+        const VertexId v = basins.minimum[m];
+        vector<float> pos = index_to_position(search.cellIndex(v));
+        out << c << " " << search.cellIndex(v) << " " << pos[0] << " " << pos[1] << " " << pos[2] << " "
+            << data[v] << " " << (basins.merged_into[m] == NOTHING ? root_cap : basins.saddle[m]) << " "
+            << basins.persistence[m] << " "
+            << region[c].cells << " " << region[c].mass / 2.0e33 << " "
+            << num_bound[c] << " " << bound_mass[c] / 2.0e33 << " " << num_sinks[c] << " "
+            << region[c].com_vel[0] << " " << region[c].com_vel[1] << " " << region[c].com_vel[2] << " "
+            << region[c].sigma_v << " "
+            << sqrt(region[c].L[0]*region[c].L[0] + region[c].L[1]*region[c].L[1]
+                    + region[c].L[2]*region[c].L[2]) << " "
+            << region[c].virialRatio() << endl;
+    }
+    cout << "CoreAnalyzer::findAllCores() --> wrote " << num_cores << " cores to "
+         << catalogue_file << endl << endl;
+}
 
-        double cell_mass = cell_vol*data_map["dens_pp"][*it];
 
-        vx_rel = data_map["velx_pp"][*it] - core_CoM_velx;
-        vy_rel = data_map["vely_pp"][*it] - core_CoM_vely;
-        vz_rel = data_map["velz_pp"][*it] - core_CoM_velz; 
-        Ekin = 0.5 * cell_mass * (vx_rel*vx_rel + vy_rel*vy_rel + vz_rel*vz_rel);
 
-        Etherm = cell_mass * data_map["eint"][*it];
+void CoreAnalyzer::findComponents(const std::string field, const float threshold, const bool above,
+                                  const std::string catalogue_file)
+{
+    cout << "CoreAnalyzer::findComponents() called... " << endl;
 
-        Egrav = cell_mass * (data_map["gpot"][*it]-reference_gpot);
+    int f = 0;
+    while (f < NUM_FIELDS && field != fieldInfo(FieldId(f)).file) ++f;
+    if (f == NUM_FIELDS)
+    {
+        cerr << "PROBLEM!!! unknown field: " << field << endl;
+        return;
+    }
+    Connectivity conn = connectivity;
+    if (conn == CONN_TET)
+    {
+        cout << "tet connectivity has no fixed stencil, labelling with 6 (faces)" << endl;
+        conn = CONN_6;
+    }
 
-        Etotal = Ekin + Etherm + Egrav;
-        if (Etotal < 0.0)
-        {
-            bound_core_mass += cell_mass;
-            ++num_bound_cells;
-        }
-        if (*it == sink_cell_index)
+    fields.require(BOUND_MASS_FIELDS);  // the thresholded field, and the rest for the catalogue
+    const unsigned int size[3] = { unsigned(pixel_size), unsigned(pixel_size), unsigned(pixel_size) };
+    Components components;
+    labelComponents(fields.ptr(FieldId(f)), size, threshold, above, conn, components);
+    const VertexId num_components = components.count();
+    cout << num_components << " components of " << field << (above ? " > " : " < ") << threshold
+         << " with " << int(conn) << " connectivity" << endl;
+
+    const CellEnergetics cells(fields, cell_vol);
+    const double origin[3] = { minmax_xyz[0], minmax_xyz[2], minmax_xyz[4] };
+    vector<RegionMoments> moments;
+    reduceRegions(cells, size, &components.label[0], num_components, moments);
+
+    std::ofstream out(catalogue_file.c_str(), std::ios::out);
+    if (!out)
+    {
+        cerr << "PROBLEM!!! couldn't open output file " << catalogue_file << endl;
+        return;
+    }
+    out << "# " << field << (above ? " > " : " < ") << threshold << ", connectivity "
+        << int(conn) << endl;
+    out << "# component first_index cells mass(Msol) CoM_x CoM_y CoM_z CoM_velx CoM_vely CoM_velz"
+        << " sigma_v(cm/s) virial_ratio" << endl;
+    for (VertexId c = 0; c < num_components; ++c)
+    {
+        RegionStats r;
+        regionStats(moments[c], size, cell_size, origin, cell_vol, r);
+        out << c << " " << components.first[c] << " " << components.size[c] << " "
+            << r.mass / 2.0e33 << " " << r.com[0] << " " << r.com[1] << " " << r.com[2] << " "
+            << r.com_vel[0] << " " << r.com_vel[1] << " " << r.com_vel[2] << " "
+            << r.sigma_v << " " << r.virialRatio() << endl;
+    }
+    cout << "CoreAnalyzer::findComponents() --> wrote " << num_components << " components to "
+         << catalogue_file << endl << endl;
+}
+
+
+void CoreAnalyzer::writeDendrogram(const float min_value, const float min_delta, const size_t min_cells,
+                                   const std::string filename)
+{
+    cout << "CoreAnalyzer::writeDendrogram() called... " << endl;
+
+    fields.require(fieldBit(FIELD_DENS));
+    Data<float> data;
+    data.wrap(fields.ptr(FIELD_DENS), pixel_size, pixel_size, pixel_size);
+    Mesh<float> mesh(data);
+
+    const DendrogramParams params = { min_value, min_delta, min_cells };
+    FlatBranchTree tree;
+    buildDendrogram(mesh, connectivity, params, tree);
+
+    unsigned int trunks = 0, leaves = 0;
+    for (unsigned int b = 0; b < tree.numNodes(); ++b)
+    {
+        trunks += tree.parent[b] == NO_BRANCH;
+        leaves += tree.num_children[b] == 0;
+    }
+    cout << tree.numNodes() << " structures (" << leaves << " leaves) in " << trunks
+         << " trees, dens > " << min_value << ", min_delta " << min_delta << ", min_cells "
+         << min_cells << endl;
+
+    if (writeBranchTree(filename, tree))
+        cout << "CoreAnalyzer::writeDendrogram() --> wrote " << filename << endl << endl;
+}
+
+
+void CoreAnalyzer::writeSinkProfiles(const double r_min, const double r_max, const unsigned int num_bins,
+                                     const std::string filename)
+{
+    cout << "CoreAnalyzer::writeSinkProfiles() called... " << endl;
+
+    if (r_min <= 0.0 || r_max <= r_min || num_bins == 0)
+    {
+        cerr << "PROBLEM!!! radial profiles need 0 < r_min < r_max and at least one bin" << endl;
+        return;
+    }
+    std::ofstream out(filename.c_str(), std::ios::out);
+    if (!out)
+    {
+        cerr << "PROBLEM!!! couldn't open output file " << filename << endl;
+        return;
+    }
+
+    vector<RadialCentre> centres(sinks.size());
+    for (size_t s = 0; s < sinks.size(); ++s)
+    {
+        const vector<float> pos = sinks[s].getPosition();
+        const vector<float> vel = sinks[s].getVelocity();
+        for (int d = 0; d < 3; ++d)
         {
-            cout << "   For cell nearest to sink:" << endl;
-            cout << "       Ekin = " << Ekin << endl;
-            cout << "       Etherm = " << Etherm << endl;
-            cout << "       Egrav = " << Egrav << endl;
-            cout << "       Total Energy = " << Etotal << endl << endl;
+            centres[s].pos[d] = pos[d];
+            centres[s].vel[d] = vel[d];
         }
     }
-    cout << "There were " << core_indices.size() << "cells" << num_bound_cells << " bound)" << endl;
-    cout << "--> Total core region mass (Msol): " << core_region_mass / 2.0e33 << endl;
-    cout << "--> Bound core mass (Msol): " << bound_core_mass / 2.0e33 << endl << endl;
 
-    return bound_core_mass;
+    fields.require(fieldBit(FIELD_DENS) | fieldBit(FIELD_VELX) | fieldBit(FIELD_VELY)
+                   | fieldBit(FIELD_VELZ));
+    const float * vel[3] = { fields.ptr(FIELD_VELX), fields.ptr(FIELD_VELY), fields.ptr(FIELD_VELZ) };
+    const unsigned int size[3] = { unsigned(pixel_size), unsigned(pixel_size), unsigned(pixel_size) };
+    const double origin[3] = { minmax_xyz[0], minmax_xyz[2], minmax_xyz[4] };
+
+    vector< vector<RadialBin> > profiles;
+    radialProfiles(fields.ptr(FIELD_DENS), vel, size, origin, cell_size, centres,
+                   r_min * cell_size, r_max * cell_size, num_bins, profiles);
+    writeRadialProfiles(profiles, cell_vol, out);
+    cout << "CoreAnalyzer::writeSinkProfiles() --> wrote " << centres.size() << " sinks x "
+         << num_bins << " bins to " << filename << endl << endl;
+}
+
+
+float CoreAnalyzer::calculateBoundMass ()
+{
+    cout << "cell_vol = " << cell_vol << endl;
+
+    fields.require(BOUND_MASS_FIELDS);
+    const CellEnergetics cells(fields, cell_vol);
+    BoundMass b;
+    if (unbind_iterations > 1)
+    {
+        const unsigned int rounds = unbindIteratively(cells, CellList(core_indices), unbind_iterations,
+                                                      core_cell_energies, b);
+        cout << "Iterative unbinding: " << rounds << " rounds" << endl;
+    }
+    else
+    {
+        computeBoundMass(cells, CellList(core_indices), core_cell_energies, b);
+    }
+    cout << "Reference (max in core region) gpot: " << b.reference_gpot << endl;
+
+    if (std::find(core_indices.begin(), core_indices.end(), sink_cell_index) != core_indices.end())
+    {
+        double Ekin, Etherm, Egrav;
+        cells.energies(sink_cell_index, b, Ekin, Etherm, Egrav);
+        cout << "   For cell nearest to sink:" << endl;
+        cout << "       Ekin = " << Ekin << endl;
+        cout << "       Etherm = " << Etherm << endl;
+        cout << "       Egrav = " << Egrav << endl;
+        cout << "       Total Energy = " << Ekin + Etherm + Egrav << endl << endl;
+    }
+    cout << "There were " << core_indices.size() << "cells" << b.num_bound << " bound)" << endl;
+    cout << "--> Total core region mass (Msol): " << b.region_mass / 2.0e33 << endl;
+    cout << "--> Bound core mass (Msol): " << b.bound_mass / 2.0e33 << endl;
+    cout << "--> Virial ratio 2(Ekin + Etherm)/|Egrav|: " << b.virialRatio() << endl << endl;
+
+    core_region_mass = b.region_mass;
+    bound_core_region_mass = b.bound_mass;
+    return b.bound_mass;
+}
+
+void CoreAnalyzer::setUnbindIterations(const unsigned int max_iterations)
+{
+    unbind_iterations = max_iterations > 0 ? max_iterations : 1;
+}
+
+// the box of cells within radius (in cells, along each axis) of the sink, taken as the region
+float CoreAnalyzer::calculateBoundMassInBox (const unsigned int radius)
+{
+    fields.require(BOUND_MASS_FIELDS);
+    uint x, y, z;
+    RowMajor::coords(sink_cell_index, fields.view(FIELD_GPOT).extent, x, y, z);
+    const VolumeView<float> box = boxAround(fields.view(FIELD_GPOT), x, y, z, radius);
+
+    BoundMass b;
+    vector<double> box_energies;
+    computeBoundMass(CellEnergetics(fields, cell_vol), box, box_energies, b);
+
+    cout << "Box of " << box.extent[0] << "x" << box.extent[1] << "x" << box.extent[2]
+         << " cells around the sink: " << b.num_bound << " bound" << endl;
+    cout << "--> Box mass (Msol): " << b.region_mass / 2.0e33 << endl;
+    cout << "--> Bound box mass (Msol): " << b.bound_mass / 2.0e33 << endl;
+    cout << "--> Virial ratio 2(Ekin + Etherm)/|Egrav|: " << b.virialRatio() << endl << endl;
+
+    return b.bound_mass;
+}
+
+
+void CoreAnalyzer::writeSinkProjections(const unsigned int radius, const std::string filename)
+{
+    cout << "CoreAnalyzer::writeSinkProjections() called... " << endl;
+
+    // the core region as a mask, if it has been found
+    LabelVolume<2> core_mask;
+    if (!core_indices.empty())
+    {
+        core_mask.reset(n_elems);
+        for (size_t k = 0; k < core_indices.size(); ++k) core_mask.set(core_indices[k], 1);
+    }
+    else
+    {
+        cout << "no core region found yet, projecting without the core overlay" << endl;
+    }
+
+    fields.require(fieldBit(FIELD_DENS) | fieldBit(FIELD_VELX) | fieldBit(FIELD_VELY)
+                   | fieldBit(FIELD_VELZ));
+    const float * vel[3] = { fields.ptr(FIELD_VELX), fields.ptr(FIELD_VELY), fields.ptr(FIELD_VELZ) };
+    const VolumeView<float> grid = fields.view(FIELD_DENS);
+
+    HDFIO file;
+    file.create(filename);
+    for (size_t s = 0; s < sinks.size(); ++s)
+    {
+        uint x, y, z;
+        RowMajor::coords(position_to_index(sinks[s].getPosition()), grid.extent, x, y, z);
+        const VolumeView<float> box = boxAround(grid, x, y, z, radius);
+
+        ProjectionMap maps[3];
+        projectBox(box, fields.ptr(FIELD_DENS), vel, core_indices.empty() ? NULL : &core_mask,
+                   cell_size, maps);
+        std::ostringstream prefix;
+        prefix << "sink" << s;
+        writeProjections(file, prefix.str(), maps);
+    }
+    file.close();
+    cout << "CoreAnalyzer::writeSinkProjections() --> wrote " << sinks.size() << " sink boxes to "
+         << filename << endl << endl;
+}
+
+
+float CoreAnalyzer::getRegionVolume()
+{
+    return core_volume;
 }
 
 
@@ -368,14 +952,140 @@ float CoreAnalyzer::calculateBoundMass ()
  *      PRIVATE FUNCTIONS
  */
 
-void CoreAnalyzer::setVariableNames()
+// contour tree of data (gpot or its sort keys) in the given order, integrating every arc
+template <typename T, typename L>
+void CoreAnalyzer::sweepCoreRegion(Data<T, L> & data, std::vector<VertexId> & totalOrder)
 {
-    var_names.push_back("gpot");
-    var_names.push_back("dens_pp");     // I think the "_pp" just means sink contrib. added
-    var_names.push_back("eint");
-    var_names.push_back("velx_pp");
-    var_names.push_back("vely_pp");
-    var_names.push_back("velz_pp");
+    Mesh<T, L> mesh(data);
+    std::vector<size_t> ctOrder;
+    SweepData<T, L> sweep;
+    sweep.mesh = &mesh;
+    sweep.cell_vol = cell_vol;
+    sweep.dens = fields.ptr(FIELD_DENS);
+    sweep.velx = fields.ptr(FIELD_VELX);
+    sweep.vely = fields.ptr(FIELD_VELY);
+    sweep.velz = fields.ptr(FIELD_VELZ);
+    sweep.gpot = fields.ptr(FIELD_GPOT);
+
+    size_t (*neighborFunc)(size_t, size_t*, void*) = &neighbors<T, L, CONN_TET>;
+    if (connectivity == CONN_6) neighborFunc = &neighbors<T, L, CONN_6>;
+    else if (connectivity == CONN_18) neighborFunc = &neighbors<T, L, CONN_18>;
+    else if (connectivity == CONN_26) neighborFunc = &neighbors<T, L, CONN_26>;
+
+    //init libtourtre
+    ctContext * ctx = ct_init(
+        data.totalSize, //numVertices
+        widenOrder( totalOrder, ctOrder ), // c array style, of size_t
+        &value<T, L>, // callback funcs
+        neighborFunc,
+        &sweep //data for callbacks.
+    );
+    ct_vertexFunc( ctx, &accumulateVertex<T, L> );  // per-arc integrals, on the fly
+    ct_arcMergeFunc( ctx, &mergeArcs<T, L> );
+    cout << "Initialized ctContext" << endl;
+
+    //create contour tree
+    ct_sweepAndMerge( ctx );
+
+    ct_decompose( ctx );
+
+    // ARC MAPPING STUFF
+    cout << "Getting arc_map..." << endl;
+    ctArc ** arc_map = ct_arcMap( ctx );
+    vector<ctArc*> arc_vec(arc_map, arc_map + data.totalSize);
+    cout << "size of arc_vec = " << arc_vec.size() << endl;
+
+    ctArc * sink_arcptr = arc_vec[data.fromRowMajor(sink_cell_index)];
+
+    vector<ctArc*>::const_iterator arc_it;
+    VertexId i(0);
+    ctArc * last_arc = NULL;
+    for (arc_it = arc_vec.begin(); arc_it != arc_vec.end(); ++arc_it)
+    {
+        if (*arc_it == sink_arcptr) // if cell is associated with same arc as sink
+        {
+            core_indices.push_back(data.toRowMajor(i));
+        }
+        if (*arc_it != last_arc && (*arc_it)->data != NULL) setArcEnds(*arc_it, data);
+        last_arc = *arc_it;
+        i++;
+    }
+    cout << "core_indices have been set... there are " << core_indices.size() << " cells" << endl;
+
+    // copied out before the integrals are freed below
+    const bool sink_arc_found = sink_arcptr->data != NULL;
+    ArcIntegrals sink_arc;
+    if (sink_arc_found) sink_arc = *static_cast<ArcIntegrals*>(sink_arcptr->data);
+
+    // keep the integrals of every arc that still owns cells
+    arc_integrals.clear();
+    vector< ArcIntegrals* >::const_iterator int_it;
+    for (int_it = sweep.integrals.begin(); int_it != sweep.integrals.end(); ++int_it)
+    {
+        if ((*int_it)->num_cells > 0) arc_integrals.push_back(**int_it);
+        delete *int_it;
+    }
+    sweep.integrals.clear();
+
+    if (sink_arc_found)
+    {
+        core_volume = sink_arc.volume;
+        core_region_mass = sink_arc.mass;
+        cout << "Sink arc integrals: " << sink_arc.num_cells << " cells, volume "
+             << sink_arc.volume << " cm^3, mass (Msol) " << sink_arc.mass / 2.0e33 << endl;
+        cout << "       gpot range [" << sink_arc.gpot_min << ", " << sink_arc.gpot_max << "]" << endl;
+    }
+    cout << "Integrals kept for " << arc_integrals.size() << " arcs" << endl << endl;
+
+    ct_cleanup( ctx );
+}
+
+// subtracts the sink potentials from gpot[0, count), which holds cells first_index onwards
+void CoreAnalyzer::addSinkGravity(float * gpot, const unsigned int first_index, const unsigned int count)
+{
+    for (unsigned int j = 0; j < count; ++j)
+    {
+        unsigned int i = first_index + j;   // flat index in the whole grid
+        vector<float> cell_pos = index_to_position(i);
+
+        // iterate over sink particles
+        vector<Sink>::const_iterator sink_it;
+        int sink_counter = 0;
+        for (sink_it = sinks.begin(); sink_it != sinks.end(); ++sink_it)
+        {
+            float dist_to_sink = vec_distance(cell_pos, sink_it->getPosition());
+
+            if (dist_to_sink == 0.0){
+                cout << "THERE WAS A DISTANCE = 0!!!" << endl;
+                dist_to_sink = 0.01;
+            }
+
+
+            if ((sink_counter == sink_id) && (dist_to_sink < min_distance))
+            {
+                min_distance = dist_to_sink;
+                sink_cell_index = i;
+            }
+
+            gpot[j] -= G*sink_it->getMass() / dist_to_sink;
+
+            sink_counter++;
+        }
+    }
+}
+
+// grid dimensions (x fastest) and cell sizes straight from the gpot file, without loading it
+void CoreAnalyzer::readGridGeometry(unsigned int size[3])
+{
+    std::string filename = data_directory + "extracted_gpot";
+    vector<int> dims = getDimsFromHDF(filename, "gpot");   // slowest (z) first
+    for (int d = 0; d < 3; ++d) { size[d] = dims[2-d]; }
+
+    pixel_size = size[0];
+    n_elems = std::vector<float>::size_type(size[0]) * size[1] * size[2];
+    minmax_xyz.assign(6, 0.0);
+    loadArrayFromHDF(&minmax_xyz[0], filename, "minmax_xyz");
+    set_cell_size();
 }
 
 vector<float> CoreAnalyzer::index_to_position(const unsigned int id)
@@ -408,26 +1118,45 @@ vector<float> CoreAnalyzer::index_to_position(const unsigned int id)
     return position;
 }
 
-void CoreAnalyzer::check_bounds_map()   // make sure bounds are okay
+// nearest cell to a position, clamped to the grid
+unsigned int CoreAnalyzer::position_to_index(const vector<float> & position)
 {
-    vector< std::string >::const_iterator it;
-    for (it = var_names.begin()+1; it != var_names.end(); ++it)
+    int ijk[3];
+    for (int d = 0; d < 3; ++d)
     {
-        if (! std::equal(bounds_map[*it].begin(),
-                        bounds_map[*it].end(),
-                        bounds_map[*(it-1)].begin()))
+        ijk[d] = int((position[d] - minmax_xyz[2*d]) / cell_size);
+        if (ijk[d] < 0) ijk[d] = 0;
+        if (ijk[d] >= pixel_size) ijk[d] = pixel_size - 1;
+    }
+    return (ijk[2]*pixel_size + ijk[1])*pixel_size + ijk[0];
+}
+
+void CoreAnalyzer::check_bounds()   // make sure bounds are okay
+{
+    for (int f = 1; f < NUM_FIELDS; ++f)
+    {
+        const char * prev = fieldInfo(FieldId(f-1)).name;
+        const char * name = fieldInfo(FieldId(f)).name;
+        if (! std::equal(fields.bounds(FieldId(f)),
+                        fields.bounds(FieldId(f)) + 6,
+                        fields.bounds(FieldId(f-1))))
         {
             cerr << "PROBLEM!!! --> unequal bounds for: ";
-            cerr << *(it-1) << "and" << *it << endl;
+            cerr << prev << "and" << name << endl;
         }
         else
         {
-            cout << "Data bounds matched: " << *(it-1) << " and " << *it << endl;
+            cout << "Data bounds matched: " << prev << " and " << name << endl;
         }
     }
     cout << endl;
 
-    minmax_xyz = bounds_map["gpot"];
+    minmax_xyz.assign(fields.bounds(FIELD_GPOT), fields.bounds(FIELD_GPOT) + 6);
+    set_cell_size();
+}
+
+void CoreAnalyzer::set_cell_size()  // from minmax_xyz and pixel_size
+{
     cell_size = (minmax_xyz[1] - minmax_xyz[0])/pixel_size;
     half_cell = cell_size * 0.5;
     cell_vol = cell_size * cell_size * cell_size;
@@ -436,19 +1165,15 @@ void CoreAnalyzer::check_bounds_map()   // make sure bounds are okay
 void CoreAnalyzer::check_data_minmax()
 {
     cout << "Data minimum and maximum check:" << endl;
-    vector< std::string >::const_iterator it;
-    for (it = var_names.begin(); it != var_names.end(); ++it)
-    {
-        vector<float>::iterator biggest;
-        biggest = std::max_element(data_map[*it].begin(), data_map[*it].end());
-        vector<float>::iterator smallest;
-        smallest = std::min_element(data_map[*it].begin(), data_map[*it].end());
-
-        cout << "       " << *it << ":" << endl;
-        cout << "           Max: " << *biggest; 
-        cout << "       at index: " << std::distance(data_map[*it].begin(), biggest) << endl;
-        cout << "           Min: " << *smallest;
-        cout << "       at index: " << std::distance(data_map[*it].begin(), smallest) << endl;
+    for (int f = 0; f < NUM_FIELDS; ++f)
+    {
+        const FieldStore::Field & meta = fields.meta(FieldId(f));
+
+        cout << "       " << fieldInfo(FieldId(f)).name << ":" << endl;
+        cout << "           Max: " << meta.maxValue; 
+        cout << "       at index: " << meta.maxIndex << endl;
+        cout << "           Min: " << meta.minValue;
+        cout << "       at index: " << meta.minIndex << endl;
         cout << endl;
     }
 }
@@ -4,43 +4,107 @@
 #include <cstdlib>
 #include <iostream>
 #include <vector>
+#include <stdint.h>
 using std::cout;    using std::endl;
 using std::vector;
 
-bool Data::less( uint a, uint b ) 
+template <typename T, typename L>
+bool Data<T, L>::less( VertexId a, VertexId b ) 
 {
 	//use overloaded [] operator to access saddles
-	if (compareEqual( (*this)[a],(*this)[b])) return a < b;
+	//ties go by row-major index, so every layout gives the same order
+	if (compareEqual( (*this)[a],(*this)[b])) return toRowMajor(a) < toRowMajor(b);
 	else return compareLess((*this)[a],(*this)[b]);
 }
 
-bool Data::greater( uint a, uint b ) 
+template <typename T, typename L>
+bool Data<T, L>::greater( VertexId a, VertexId b ) 
 {
-	if (compareEqual((*this)[a],(*this)[b])) return a > b;
+	if (compareEqual((*this)[a],(*this)[b])) return toRowMajor(a) > toRowMajor(b);
 	else return compareLess((*this)[b],(*this)[a]);
 }
 
-void Data::loadFromVector(const vector<float>& gpot, const vector<float>::size_type num_points) 
+template <typename T, typename L>
+void Data<T, L>::loadFromVector(const vector<float>& gpot, const uint dims[3]) 
 {
     cout << "Data::loadFromVector called..." << endl;
 
-    totalSize = num_points;
-    data = new DataType[totalSize];
-
-    for(uint i = 0; i < totalSize; ++i)
+    if (gpot.size() != size_t(dims[0]) * dims[1] * dims[2])
     {
-        data[i] = static_cast<DataType>(gpot[i]);
+        std::cerr << "PROBLEM!!! Data::loadFromVector got " << gpot.size() << " values for a "
+                  << dims[0] << "x" << dims[1] << "x" << dims[2] << " grid" << endl;
+        return;
     }
+    loadFromArray(gpot.empty() ? NULL : &gpot[0], dims[0], dims[1], dims[2]);
+
+    cout << "... max value was " << maxValue << " and min value was " << minValue << endl;
+}
+
+// quiet version of the above for blocks of arbitrary dimensions (e.g. slabs of a larger volume)
+template <typename T, typename L>
+void Data<T, L>::loadFromArray(const float * values, const uint nx, const uint ny, const uint nz)
+{
+    release();
+
+    size[0] = nx;
+    size[1] = ny;
+    size[2] = nz;
+    totalSize = VertexId(nx) * ny * nz;
+    data = new T[totalSize];
+    owner = true;
+
+    scatter(values);
+    findMinMax();
+}
+
+template <typename T, typename L>
+void Data<T, L>::wrap(T * values, const uint nx, const uint ny, const uint nz)
+{
+    release();
+
+    size[0] = nx;
+    size[1] = ny;
+    size[2] = nz;
+    totalSize = VertexId(nx) * ny * nz;
+    data = values;
+    owner = false;
 
+    findMinMax();
+}
+
+template <typename T, typename L>
+void Data<T, L>::release()
+{
+    if (data && owner) delete[] data;
+    data = 0;
+    owner = false;
+}
+
+template <typename T, typename L>
+void Data<T, L>::findMinMax()
+{
     maxValue = minValue = data[0];
-    for (uint i = 0; i < totalSize; i++) {
+    for (VertexId i = 0; i < totalSize; i++) {
         if (data[i] > maxValue) maxValue = data[i];
         if (data[i] < minValue) minValue = data[i];
     }
+}
 
-    size[0] = 512;
-    size[1] = 512;
-    size[2] = 512;
-
-    cout << "... max value was " << maxValue << " and min value was " << minValue << endl;
+// copies row-major values into data, in layout L
+template <typename T, typename L>
+void Data<T, L>::scatter(const float * values)
+{
+    VertexId r = 0;
+    for (uint z = 0; z < size[2]; z++)
+        for (uint y = 0; y < size[1]; y++)
+            for (uint x = 0; x < size[0]; x++, r++)
+                data[L::index(x, y, z, size)] = static_cast<T>(values[r]);
 }
+
+// the value types and layouts used in this code
+template struct Data<float>;
+template struct Data<double>;
+template struct Data<uint16_t>;   // quantized sort keys
+template struct Data<uint32_t>;
+template struct Data<float, Brick>;
+template struct Data<float, Morton>;
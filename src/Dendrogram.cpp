@@ -0,0 +1,293 @@
+/*
+ *  Density dendrogram: split tree of the dens maxima with min_delta / min_cells pruning
+ *
+ *  Source Outline:
+ *      - Local types and funcs
+ *      - buildDendrogram
+ */
+
+#include "Dendrogram.hpp"
+
+#include <vector>
+#include <algorithm>    // std::sort, std::inplace_merge
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using std::vector;
+
+// LOCAL types and functions
+
+class DescendingOrder
+{
+    Data<float> & data;
+    public:
+    DescendingOrder(Data<float> & d) : data(d) {}
+    bool operator()(const VertexId a, const VertexId b) const { return data.greater(a, b); }
+};
+
+// the cells above min_value, in descending Data::greater() order
+void sortCandidates(Data<float> & data, const float min_value, vector< VertexId > & order)
+{
+    int num_chunks = 1;
+#ifdef _OPENMP
+    num_chunks = omp_get_max_threads();
+#endif
+    const long n = data.totalSize;
+
+    // count, prefix sum, then copy out, so the cells stay in index order whatever the threads
+    vector< size_t > first(num_chunks + 1, 0);
+    #pragma omp parallel for schedule(static, 1)
+    for (int c = 0; c < num_chunks; ++c)
+    {
+        size_t count = 0;
+        for (long i = (n * c) / num_chunks; i < (n * (c + 1)) / num_chunks; ++i)
+            count += data.data[i] > min_value;
+        first[c + 1] = count;
+    }
+    for (int c = 0; c < num_chunks; ++c) first[c + 1] += first[c];
+
+    order.resize(first[num_chunks]);
+    #pragma omp parallel for schedule(static, 1)
+    for (int c = 0; c < num_chunks; ++c)
+    {
+        size_t k = first[c];
+        for (long i = (n * c) / num_chunks; i < (n * (c + 1)) / num_chunks; ++i)
+            if (data.data[i] > min_value) order[k++] = i;
+    }
+
+    // each chunk sorted on its own, then merged pairwise, a level at a time
+    const DescendingOrder descending(data);
+    const size_t m = order.size();
+    #pragma omp parallel for schedule(static, 1)
+    for (int c = 0; c < num_chunks; ++c)
+        std::sort(order.begin() + (m * c) / num_chunks, order.begin() + (m * (c + 1)) / num_chunks,
+                  descending);
+
+    for (int width = 1; width < num_chunks; width *= 2)
+    {
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int c = 0; c < num_chunks - width; c += 2 * width)
+        {
+            const int end = c + 2 * width < num_chunks ? c + 2 * width : num_chunks;
+            std::inplace_merge(order.begin() + (m * c) / num_chunks,
+                               order.begin() + (m * (c + width)) / num_chunks,
+                               order.begin() + (m * end) / num_chunks, descending);
+        }
+    }
+}
+
+struct Structure
+{
+    VertexId peak;      // densest cell, children included
+    VertexId saddle;    // where it met its parent, else the last cell it took
+    size_t cells;       // its own, merged leaves included
+    VertexId parent;    // the branch it is a child of, NOTHING if none (yet)
+    VertexId top;       // towards the outermost structure it is part of
+    VertexId owner;     // for a merged leaf: the structure that took its cells, else itself
+    bool leaf;
+
+    Structure(const VertexId v, const bool is_leaf, const VertexId id) :
+        peak(v), saddle(v), cells(1), parent(NOTHING), top(id), owner(id), leaf(is_leaf) {}
+};
+
+VertexId findTop(vector< Structure > & s, VertexId k)
+{
+    while (s[k].top != k)
+    {
+        s[k].top = s[s[k].top].top;     // path halving
+        k = s[k].top;
+    }
+    return k;
+}
+
+// merges leaf k (cells and all) into structure into
+void absorb(vector< Structure > & s, const float * values, const VertexId k, const VertexId into)
+{
+    s[k].top = s[k].owner = into;
+    s[into].cells += s[k].cells;
+    if (values[s[k].peak] > values[s[into].peak]) s[into].peak = s[k].peak;
+}
+
+struct TopCollector
+{
+    const vector< VertexId > & cell_structure;
+    vector< Structure > & s;
+    VertexId tops[26];
+    int num_tops;
+
+    void operator()(const VertexId n)
+    {
+        if (cell_structure[n] == NOTHING) return;
+        const VertexId t = findTop(s, cell_structure[n]);
+        for (int k = 0; k < num_tops; ++k)
+            if (tops[k] == t) return;
+        tops[num_tops++] = t;
+    }
+};
+
+template <int Conn>
+void sweep(Mesh<float> & mesh, const vector< VertexId > & order, const DendrogramParams & params,
+           vector< VertexId > & cell_structure, vector< Structure > & s)
+{
+    const float * values = mesh.data.data;
+    TopCollector collect = { cell_structure, s, {}, 0 };
+
+    for (size_t k = 0; k < order.size(); ++k)
+    {
+        const VertexId v = order[k];
+        collect.num_tops = 0;
+        mesh.visitNeighbors<Conn>(v, collect);
+
+        if (collect.num_tops == 0)
+        {
+            cell_structure[v] = s.size();
+            s.push_back(Structure(v, true, s.size()));
+            continue;
+        }
+
+        VertexId joined = collect.tops[0];
+        if (collect.num_tops > 1)
+        {
+            bool significant[26];
+            int num_significant = 0;
+            for (int t = 0; t < collect.num_tops; ++t)
+            {
+                const Structure & c = s[collect.tops[t]];
+                significant[t] = !c.leaf || (values[c.peak] - values[v] >= params.min_delta &&
+                                             c.cells >= params.min_cells);
+                num_significant += significant[t];
+            }
+
+            if (num_significant >= 2)
+            {
+                joined = s.size();
+                s.push_back(Structure(v, false, joined));
+                s[joined].cells = 0;
+                for (int t = 0; t < collect.num_tops; ++t)
+                {
+                    const VertexId c = collect.tops[t];
+                    if (!significant[t])
+                    {
+                        absorb(s, values, c, joined);
+                        continue;
+                    }
+                    s[c].parent = s[c].top = joined;
+                    s[c].saddle = v;
+                    if (values[s[c].peak] > values[s[joined].peak]) s[joined].peak = s[c].peak;
+                }
+            }
+            else
+            {
+                // the significant one keeps the rest, else the one with the highest peak
+                int keep = 0;
+                for (int t = 1; t < collect.num_tops; ++t)
+                    if (significant[t] || (!significant[keep] &&
+                                           values[s[collect.tops[t]].peak] > values[s[collect.tops[keep]].peak]))
+                        keep = t;
+                joined = collect.tops[keep];
+                for (int t = 0; t < collect.num_tops; ++t)
+                    if (t != keep) absorb(s, values, collect.tops[t], joined);
+            }
+        }
+
+        cell_structure[v] = joined;
+        s[joined].cells++;
+        s[joined].saddle = v;
+    }
+}
+
+
+/*
+ *      buildDendrogram
+ */
+
+void buildDendrogram(Mesh<float> & mesh, const Connectivity connectivity,
+                     const DendrogramParams & params, FlatBranchTree & tree)
+{
+    Data<float> & data = mesh.data;
+    const float * values = data.data;
+
+    vector< VertexId > order;
+    sortCandidates(data, params.min_value, order);
+
+    vector< VertexId > cell_structure(data.totalSize, NOTHING);
+    vector< Structure > s;
+    if (connectivity == CONN_6) sweep<CONN_6>(mesh, order, params, cell_structure, s);
+    else if (connectivity == CONN_18) sweep<CONN_18>(mesh, order, params, cell_structure, s);
+    else if (connectivity == CONN_26) sweep<CONN_26>(mesh, order, params, cell_structure, s);
+    else sweep<CONN_TET>(mesh, order, params, cell_structure, s);
+
+    // trunks that are a lone insignificant leaf are dropped, with every leaf merged into them
+    const VertexId num_structures = s.size();
+    vector< bool > kept(num_structures, false);
+    vector< VertexId > trunks;
+    for (VertexId k = 0; k < num_structures; ++k)
+    {
+        if (s[k].owner != k) continue;
+        kept[k] = true;
+        if (s[k].parent != NOTHING) continue;
+        if (s[k].leaf && (values[s[k].peak] - values[s[k].saddle] < params.min_delta ||
+                          s[k].cells < params.min_cells))
+            kept[k] = false;
+        else
+            trunks.push_back(k);
+    }
+    std::sort(trunks.begin(), trunks.end(),
+              [&](const VertexId a, const VertexId b) { return data.greater(s[a].peak, s[b].peak); });
+
+    vector< VertexId > num_children(num_structures, 0), first_child(num_structures + 1, 0);
+    for (VertexId k = 0; k < num_structures; ++k)
+        if (kept[k] && s[k].parent != NOTHING) num_children[s[k].parent]++;
+    for (VertexId k = 0; k < num_structures; ++k) first_child[k + 1] = first_child[k] + num_children[k];
+    vector< VertexId > children(first_child[num_structures]);
+    vector< VertexId > filled(first_child.begin(), first_child.end() - 1);
+    for (VertexId k = 0; k < num_structures; ++k)
+        if (kept[k] && s[k].parent != NOTHING) children[filled[s[k].parent]++] = k;
+
+    // breadth-first from the trunks, so the children of every node are contiguous
+    tree = FlatBranchTree();
+    vector< VertexId > queue(trunks);
+    vector< uint32_t > node_of(num_structures, NO_BRANCH);
+    tree.parent.assign(trunks.size(), NO_BRANCH);
+    for (size_t q = 0; q < queue.size(); ++q)
+    {
+        const VertexId k = queue[q];
+        node_of[k] = q;
+        tree.extremum.push_back(s[k].peak);
+        tree.saddle.push_back(s[k].saddle);
+        tree.extremum_value.push_back(values[s[k].peak]);
+        tree.saddle_value.push_back(values[s[k].saddle]);
+        tree.first_child.push_back(queue.size());
+        tree.num_children.push_back(num_children[k]);
+        for (VertexId c = first_child[k]; c < first_child[k + 1]; ++c)
+        {
+            queue.push_back(children[c]);
+            tree.parent.push_back(q);
+        }
+    }
+
+    // cells of merged leaves go to the structure that took them, dropped trunks' to none
+    vector< uint32_t > final_node(num_structures, NO_BRANCH);
+    for (VertexId k = 0; k < num_structures; ++k)
+    {
+        VertexId o = k;
+        while (s[o].owner != o) o = s[o].owner;
+        final_node[k] = kept[o] ? node_of[o] : NO_BRANCH;
+    }
+    const uint num_nodes = queue.size();
+    const long num_swept = order.size();
+    tree.arc_size.assign(num_nodes, 0);
+    #pragma omp parallel
+    {
+        vector< uint64_t > count(num_nodes, 0);
+        #pragma omp for schedule(static)
+        for (long k = 0; k < num_swept; ++k)
+        {
+            const uint32_t node = final_node[cell_structure[order[k]]];
+            if (node != NO_BRANCH) count[node]++;
+        }
+        #pragma omp critical
+        for (uint b = 0; b < num_nodes; ++b) tree.arc_size[b] += count[b];
+    }
+}
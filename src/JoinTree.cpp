@@ -0,0 +1,382 @@
+/*
+ *  JoinTree construction and the out-of-core (slab streaming) builder
+ *
+ *  Source Outline:
+ *      - Local sweep helper
+ *      - JoinTree member funcs
+ *      - Slab trees and stitching
+ *      - OutOfCoreJoinTree
+ */
+
+#include "JoinTree.hpp"
+#include "Mesh.h"
+#include "Data.h"
+
+#include <algorithm>    // std::sort, std::max
+#include <utility>      // std::pair
+#include <iostream>
+#include <assert.h>
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+// LOCAL helpers
+
+/*
+ * Union-find sweep shared by the slab and the stitching passes. Vertices are added in
+ * ascending order; a vertex becomes a tree node if it starts a component (minimum), joins
+ * two or more (saddle), or the caller asks to keep it (block boundary).
+ */
+class JoinSweep
+{
+    private:
+        vector< VertexId > uf;      // union-find parent, NOTHING until the vertex is swept
+        vector< VertexId > head;    // lowest kept node above the component (valid at roots)
+        vector< VertexId > roots;   // distinct components below the current vertex
+        JoinTree & tree;
+
+        VertexId find(VertexId v)
+        {
+            while (uf[v] != v) {
+                uf[v] = uf[uf[v]];  // path halving
+                v = uf[v];
+            }
+            return v;
+        }
+
+    public:
+        JoinSweep(const size_t n, JoinTree & t) : uf(n, NOTHING), head(n, NOTHING), tree(t) {}
+
+        bool swept(const VertexId v) const { return uf[v] != NOTHING; }
+
+        // returns the node created for v, or NOTHING if v was absorbed as a regular vertex
+        VertexId add(const VertexId v, const VertexId * nbrs, const uint num_nbrs, const bool keep,
+                     const size_t vertex, const float value)
+        {
+            roots.clear();
+            for (uint i = 0; i < num_nbrs; i++) {
+                if (!swept(nbrs[i])) continue;
+                VertexId r = find(nbrs[i]);
+                if (std::find(roots.begin(), roots.end(), r) == roots.end())
+                    roots.push_back(r);
+            }
+
+            if (roots.size() == 1 && !keep) {
+                uf[v] = roots[0];
+                return NOTHING;
+            }
+
+            VertexId node = tree.vertex.size();
+            tree.vertex.push_back(vertex);
+            tree.value.push_back(value);
+            tree.parent.push_back(NOTHING);
+
+            uf[v] = v;
+            head[v] = node;
+            for (uint i = 0; i < roots.size(); i++) {
+                tree.parent[head[roots[i]]] = node;
+                uf[roots[i]] = v;
+            }
+            return node;
+        }
+};
+
+//functor for sorting nodes the same way Data::less() sorts vertices
+class NodeOrder
+{
+    const vector< float > & value;
+    const vector< size_t > & vertex;
+    public:
+    NodeOrder(const vector< float > & val, const vector< size_t > & vert) : value(val), vertex(vert) {}
+    bool operator()(const VertexId & a, const VertexId & b) const {
+        if (value[a] == value[b]) return vertex[a] < vertex[b];
+        return value[a] < value[b];
+    }
+};
+
+
+/*
+ *      JoinTree MEMBER FUNCTIONS
+ */
+
+VertexId JoinTree::countMinima() const
+{
+    vector< bool > has_child(numNodes(), false);
+    for (VertexId i = 0; i < numNodes(); i++)
+        if (parent[i] != NOTHING) has_child[parent[i]] = true;
+    return std::count(has_child.begin(), has_child.end(), false);
+}
+
+VertexId JoinTree::countSaddles() const
+{
+    vector< uint > num_children(numNodes(), 0);
+    for (VertexId i = 0; i < numNodes(); i++)
+        if (parent[i] != NOTHING) num_children[parent[i]]++;
+
+    VertexId saddles = 0;
+    for (VertexId i = 0; i < numNodes(); i++)
+        if (num_children[i] > 1) saddles++;
+    return saddles;
+}
+
+size_t JoinTree::memoryUsage() const
+{
+    return vertex.capacity() * sizeof(size_t)
+         + value.capacity() * sizeof(float)
+         + parent.capacity() * sizeof(VertexId)
+         + (bottom_plane.capacity() + top_plane.capacity()) * sizeof(VertexId);
+}
+
+
+/*
+ *      SLAB TREES AND STITCHING
+ */
+
+void buildSlabJoinTree(const float * slab, const uint size[3],
+                       const uint z_begin, const uint z_end, JoinTree & tree)
+{
+    assert( z_begin % 2 == 0 );
+    assert( z_begin < z_end && z_end <= size[2] );
+
+    const uint plane_size = size[0] * size[1];
+    const uint depth = z_end - z_begin;
+    const size_t offset = size_t(z_begin) * plane_size;
+
+    tree = JoinTree();
+    tree.size[0] = size[0];
+    tree.size[1] = size[1];
+    tree.size[2] = size[2];
+    tree.z_begin = z_begin;
+    tree.z_end = z_end;
+
+    // planes that touch another block have to survive until they are stitched
+    const bool keep_bottom = (z_begin > 0);
+    const bool keep_top = (z_end < size[2]);
+    if (keep_bottom) tree.bottom_plane.assign(plane_size, NOTHING);
+    if (keep_top) tree.top_plane.assign(plane_size, NOTHING);
+
+    Data<float> data;
+    data.wrap(const_cast<float*>(slab), size[0], size[1], depth);    // only read by the sweep
+
+    Mesh<float> mesh(data);
+    vector< VertexId > order;
+    mesh.createGraph( order );  // sorts the vertices according to data.less()
+
+    JoinSweep sweep(data.totalSize, tree);
+    vector< VertexId > nbrs;
+
+    vector< VertexId >::const_iterator it;
+    for (it = order.begin(); it != order.end(); ++it)
+    {
+        const VertexId v = *it;
+        nbrs.clear();
+        mesh.getNeighbors(v, nbrs);
+
+        const uint z = v / plane_size;
+        const bool on_bottom = keep_bottom && (z == 0);
+        const bool on_top = keep_top && (z == depth - 1);
+
+        VertexId node = sweep.add(v, &nbrs[0], nbrs.size(), on_bottom || on_top,
+                                  offset + v, slab[v]);
+        if (on_bottom) tree.bottom_plane[v] = node;
+        if (on_top) tree.top_plane[v - z*plane_size] = node;
+    }
+}
+
+void stitchJoinTrees(const JoinTree & lower, const JoinTree & upper, JoinTree & merged)
+{
+    assert( lower.z_end == upper.z_begin );
+    assert( !lower.top_plane.empty() && !upper.bottom_plane.empty() );
+
+    const uint nx = lower.size[0];
+    const uint ny = lower.size[1];
+    const uint plane_size = nx * ny;
+    const VertexId num_lower = lower.numNodes();
+    const VertexId num_nodes = num_lower + upper.numNodes();
+
+    // concatenate the nodes of both trees (upper ones offset by num_lower)
+    vector< size_t > vertex(lower.vertex);
+    vertex.insert(vertex.end(), upper.vertex.begin(), upper.vertex.end());
+    vector< float > value(lower.value);
+    value.insert(value.end(), upper.value.begin(), upper.value.end());
+
+    // edges are the arcs of both trees plus the mesh edges across the shared plane
+    vector< VertexId > edge_a, edge_b;
+    for (VertexId i = 0; i < num_lower; i++) {
+        if (lower.parent[i] == NOTHING) continue;
+        edge_a.push_back(i);
+        edge_b.push_back(lower.parent[i]);
+    }
+    for (VertexId i = 0; i < upper.numNodes(); i++) {
+        if (upper.parent[i] == NOTHING) continue;
+        edge_a.push_back(num_lower + i);
+        edge_b.push_back(num_lower + upper.parent[i]);
+    }
+
+    const uint z = lower.z_end - 1;
+    for (uint y = 0; y < ny; y++) {
+        for (uint x = 0; x < nx; x++) {
+            const VertexId a = lower.top_plane[x + y*nx];
+
+            // same stencil as Mesh::find6Neighbors/find18Neighbors, restricted to z+1
+            uint nxs[5] = { x, x-1, x+1, x, x };
+            uint nys[5] = { y, y, y, y-1, y+1 };
+            const uint num_up = ((x+y+z)%2 == ODD_TET_PARITY) ? 1 : 5;
+
+            for (uint i = 0; i < num_up; i++) {
+                if (nxs[i] >= nx || nys[i] >= ny) continue;
+                edge_a.push_back(a);
+                edge_b.push_back(num_lower + upper.bottom_plane[nxs[i] + nys[i]*nx]);
+            }
+        }
+    }
+
+    // compressed adjacency lists
+    vector< VertexId > first(num_nodes + 1, 0);
+    for (size_t e = 0; e < edge_a.size(); e++) {
+        first[edge_a[e] + 1]++;
+        first[edge_b[e] + 1]++;
+    }
+    for (VertexId i = 0; i < num_nodes; i++) first[i + 1] += first[i];
+
+    vector< VertexId > adjacent(first[num_nodes]);
+    vector< VertexId > fill(first.begin(), first.end() - 1);
+    for (size_t e = 0; e < edge_a.size(); e++) {
+        adjacent[fill[edge_a[e]]++] = edge_b[e];
+        adjacent[fill[edge_b[e]]++] = edge_a[e];
+    }
+    edge_a.clear();
+    edge_b.clear();
+
+    vector< VertexId > order(num_nodes);
+    for (VertexId i = 0; i < num_nodes; i++) order[i] = i;
+    std::sort(order.begin(), order.end(), NodeOrder(value, vertex));
+
+    merged = JoinTree();
+    merged.size[0] = lower.size[0];
+    merged.size[1] = lower.size[1];
+    merged.size[2] = lower.size[2];
+    merged.z_begin = lower.z_begin;
+    merged.z_end = upper.z_end;
+
+    // only the outer planes of the merged block still need to be kept
+    vector< bool > keep(num_nodes, false);
+    for (uint i = 0; i < lower.bottom_plane.size(); i++) keep[lower.bottom_plane[i]] = true;
+    for (uint i = 0; i < upper.top_plane.size(); i++) keep[num_lower + upper.top_plane[i]] = true;
+
+    vector< VertexId > remap(num_nodes, NOTHING);
+    JoinSweep sweep(num_nodes, merged);
+
+    vector< VertexId >::const_iterator it;
+    for (it = order.begin(); it != order.end(); ++it)
+    {
+        const VertexId v = *it;
+        remap[v] = sweep.add(v, &adjacent[first[v]], first[v+1] - first[v], keep[v],
+                             vertex[v], value[v]);
+    }
+
+    if (!lower.bottom_plane.empty()) {
+        merged.bottom_plane.resize(plane_size);
+        for (uint i = 0; i < plane_size; i++)
+            merged.bottom_plane[i] = remap[lower.bottom_plane[i]];
+    }
+    if (!upper.top_plane.empty()) {
+        merged.top_plane.resize(plane_size);
+        for (uint i = 0; i < plane_size; i++)
+            merged.top_plane[i] = remap[num_lower + upper.top_plane[i]];
+    }
+}
+
+bool sameJoinTree(const JoinTree & a, const JoinTree & b)
+{
+    if (a.numNodes() != b.numNodes()) return false;
+
+    // (vertex, parent vertex) pairs don't depend on the order nodes were created in
+    typedef std::pair< size_t, size_t > Arc;
+    const size_t no_parent = size_t(-1);
+    vector< Arc > arcs_a, arcs_b;
+    for (VertexId i = 0; i < a.numNodes(); i++) {
+        arcs_a.push_back(Arc(a.vertex[i], a.parent[i] == NOTHING ? no_parent : a.vertex[a.parent[i]]));
+        arcs_b.push_back(Arc(b.vertex[i], b.parent[i] == NOTHING ? no_parent : b.vertex[b.parent[i]]));
+    }
+    std::sort(arcs_a.begin(), arcs_a.end());
+    std::sort(arcs_b.begin(), arcs_b.end());
+    return arcs_a == arcs_b;
+}
+
+
+/*
+ *      OutOfCoreJoinTree
+ */
+
+OutOfCoreJoinTree::OutOfCoreJoinTree(const uint dims[3],
+                                     const size_t budget,
+                                     SlabLoader load,
+                                     void * cbData):
+    memory_budget(budget),
+    peak_memory(0),
+    loader(load),
+    loader_data(cbData)
+{
+    size[0] = dims[0];
+    size[1] = dims[1];
+    size[2] = dims[2];
+
+    // even depth keeps every slab starting on an even plane (see buildSlabJoinTree)
+    const size_t plane_bytes = size_t(size[0]) * size[1] * bytes_per_vertex;
+    slab_depth = memory_budget / plane_bytes;
+    slab_depth -= slab_depth % 2;
+    if (slab_depth < 2) {
+        std::cerr << "OutOfCoreJoinTree: memory budget is below two planes, using 2 anyway" << endl;
+        slab_depth = 2;
+    }
+    if (slab_depth > size[2]) slab_depth = size[2];
+}
+
+void OutOfCoreJoinTree::build(JoinTree & tree)
+{
+    const size_t plane_size = size_t(size[0]) * size[1];
+    cout << "OutOfCoreJoinTree::build() --> " << size[0] << "x" << size[1] << "x" << size[2]
+         << " in slabs of " << slab_depth << " planes" << endl;
+
+    vector< float > slab;
+    JoinTree local, merged;
+    peak_memory = 0;
+
+    for (uint z_begin = 0; z_begin < size[2]; z_begin += slab_depth)
+    {
+        const uint z_end = std::min(z_begin + slab_depth, size[2]);
+
+        slab.resize(plane_size * (z_end - z_begin));
+        loader(z_begin, z_end - z_begin, &slab.front(), loader_data);
+
+        if (z_begin == 0) {
+            buildSlabJoinTree(&slab.front(), size, z_begin, z_end, tree);
+            peak_memory = slab.size() * bytes_per_vertex + tree.memoryUsage();
+            continue;
+        }
+
+        buildSlabJoinTree(&slab.front(), size, z_begin, z_end, local);
+        peak_memory = std::max(peak_memory,
+                               slab.size() * bytes_per_vertex + tree.memoryUsage()
+                               + local.memoryUsage());
+
+        stitchJoinTrees(tree, local, merged);
+        peak_memory = std::max(peak_memory,
+                               tree.memoryUsage() + local.memoryUsage() + 2*merged.memoryUsage());
+        tree.vertex.swap(merged.vertex);
+        tree.value.swap(merged.value);
+        tree.parent.swap(merged.parent);
+        tree.bottom_plane.swap(merged.bottom_plane);
+        tree.top_plane.swap(merged.top_plane);
+        tree.z_end = merged.z_end;
+
+        cout << "  ... planes [0, " << z_end << ") done, tree has "
+             << tree.numNodes() << " nodes" << endl;
+    }
+
+    cout << "OutOfCoreJoinTree::build() --> " << tree.countMinima() << " minima, "
+         << tree.countSaddles() << " saddles, est. peak memory "
+         << peak_memory / (1024*1024) << " MB" << endl;
+}
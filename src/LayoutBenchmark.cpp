@@ -0,0 +1,87 @@
+/*
+ *  Neighbour-gather benchmark over the field layouts
+ *
+ *  Source Outline:
+ *      - Local funcs
+ *      - benchmarkNeighborGather
+ */
+
+#include "LayoutBenchmark.hpp"
+#include "Data.h"
+#include "Mesh.h"
+
+#include <vector>
+#include <ctime>
+
+using std::endl;
+using std::vector;
+
+// LOCAL functions
+
+double secondsSince(const clock_t start)
+{
+    return double(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// gathers the neighbour values of every vertex in order, returns the number gathered
+template <typename L>
+double gather(Mesh<float, L> & mesh, const vector< VertexId > & order, double & checksum)
+{
+    vector< VertexId > nbrs;
+    double gathered = 0.0;
+    vector< VertexId >::const_iterator it;
+    for (it = order.begin(); it != order.end(); ++it) {
+        nbrs.clear();
+        mesh.getNeighbors(*it, nbrs);
+        for (uint i = 0; i < nbrs.size(); i++) checksum += mesh.data[nbrs[i]];
+        gathered += nbrs.size();
+    }
+    return gathered;
+}
+
+template <typename L>
+void timeLayout(const float * values, const uint size[3], std::ostream & out)
+{
+    out << "    " << L::name() << ": ";
+    if (!L::fits(size)) {
+        out << "doesn't fit the grid" << endl;
+        return;
+    }
+
+    Data<float, L> data;
+    data.loadFromArray(values, size[0], size[1], size[2]);
+    Mesh<float, L> mesh(data);
+
+    vector< VertexId > order(data.totalSize);
+    for (VertexId v = 0; v < data.totalSize; v++) order[v] = v;
+
+    double checksum = 0.0;
+    clock_t start = clock();
+    double gathered = gather(mesh, order, checksum);
+    const double scan_time = secondsSince(start);
+
+    start = clock();
+    mesh.createGraph( order );
+    const double sort_time = secondsSince(start);
+
+    start = clock();
+    gather(mesh, order, checksum);
+    const double sweep_time = secondsSince(start);
+
+    out << "sort " << sort_time << " s, storage-order gather " << gathered / scan_time / 1.0e6
+        << " M/s, sweep-order gather " << gathered / sweep_time / 1.0e6
+        << " M/s (checksum " << checksum << ")" << endl;
+}
+
+
+/*
+ *      benchmarkNeighborGather
+ */
+
+void benchmarkNeighborGather(const float * values, const uint size[3], std::ostream & out)
+{
+    out << "Neighbour gather, " << size[0] << "x" << size[1] << "x" << size[2] << " cells:" << endl;
+    timeLayout<RowMajor>(values, size, out);
+    timeLayout<Brick>(values, size, out);
+    timeLayout<Morton>(values, size, out);
+}
@@ -0,0 +1,185 @@
+/*
+ *  MPIJoinTree class implementation (only built with -DUSE_MPI)
+ *
+ *  Source Outline:
+ *      - Tree transfer
+ *      - Constructor
+ *      - build()
+ */
+
+#include "MPIJoinTree.hpp"
+
+#ifdef USE_MPI
+
+#include <algorithm>    // std::min
+#include <iostream>
+#include <vector>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::vector;
+
+// LOCAL constants
+
+enum { TAG_HEADER = 100, TAG_VERTEX, TAG_VALUE, TAG_PARENT, TAG_BOTTOM, TAG_TOP };
+
+template <typename T>
+void sendVector(const vector<T> & v, const int dest, const int tag, MPI_Comm comm)
+{
+    MPI_Send(const_cast<T*>(v.empty() ? 0 : &v.front()), v.size() * sizeof(T),
+             MPI_BYTE, dest, tag, comm);
+}
+
+template <typename T>
+void recvVector(vector<T> & v, const unsigned long n, const int source, const int tag, MPI_Comm comm)
+{
+    v.resize(n);
+    MPI_Recv(v.empty() ? 0 : &v.front(), n * sizeof(T),
+             MPI_BYTE, source, tag, comm, MPI_STATUS_IGNORE);
+}
+
+
+/*
+ *      TREE TRANSFER
+ */
+
+void sendJoinTree(const JoinTree & tree, const int dest, MPI_Comm comm)
+{
+    unsigned long header[8] = { tree.size[0], tree.size[1], tree.size[2],
+                                tree.z_begin, tree.z_end, tree.numNodes(),
+                                tree.bottom_plane.size(), tree.top_plane.size() };
+    MPI_Send(header, 8, MPI_UNSIGNED_LONG, dest, TAG_HEADER, comm);
+
+    sendVector(tree.vertex, dest, TAG_VERTEX, comm);
+    sendVector(tree.value, dest, TAG_VALUE, comm);
+    sendVector(tree.parent, dest, TAG_PARENT, comm);
+    sendVector(tree.bottom_plane, dest, TAG_BOTTOM, comm);
+    sendVector(tree.top_plane, dest, TAG_TOP, comm);
+}
+
+void recvJoinTree(JoinTree & tree, const int source, MPI_Comm comm)
+{
+    unsigned long header[8];
+    MPI_Recv(header, 8, MPI_UNSIGNED_LONG, source, TAG_HEADER, comm, MPI_STATUS_IGNORE);
+
+    tree.size[0] = header[0];
+    tree.size[1] = header[1];
+    tree.size[2] = header[2];
+    tree.z_begin = header[3];
+    tree.z_end = header[4];
+
+    recvVector(tree.vertex, header[5], source, TAG_VERTEX, comm);
+    recvVector(tree.value, header[5], source, TAG_VALUE, comm);
+    recvVector(tree.parent, header[5], source, TAG_PARENT, comm);
+    recvVector(tree.bottom_plane, header[6], source, TAG_BOTTOM, comm);
+    recvVector(tree.top_plane, header[7], source, TAG_TOP, comm);
+}
+
+
+// CONSTRUCTOR
+MPIJoinTree::MPIJoinTree(const uint dims[3],
+                         MPI_Comm communicator,
+                         SlabLoader load,
+                         void * cbData):
+    comm(communicator),
+    loader(load),
+    loader_data(cbData)
+{
+    size[0] = dims[0];
+    size[1] = dims[1];
+    size[2] = dims[2];
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_ranks);
+
+    if ((size[2] + 1) / 2 < static_cast<uint>(num_ranks))
+    {
+        if (rank == 0)
+            cerr << "MPIJoinTree: " << num_ranks << " ranks but only " << size[2] << " planes" << endl;
+        MPI_Abort(comm, 1);
+    }
+    ownedPlanes(rank, z_begin, z_end);
+}
+
+// hands out pairs of planes, so every slab starts on an even plane
+void MPIJoinTree::ownedPlanes(const int r, uint & zb, uint & ze) const
+{
+    const uint num_pairs = (size[2] + 1) / 2;
+    zb = 2 * (num_pairs * r / num_ranks);
+    ze = std::min(2 * (num_pairs * (r + 1) / num_ranks), size[2]);
+}
+
+
+/*
+ *      build()
+ */
+
+bool MPIJoinTree::build(JoinTree & tree, const bool verify)
+{
+    const size_t plane_size = size_t(size[0]) * size[1];
+    if (rank == 0)
+    {
+        cout << "MPIJoinTree::build() --> " << size[0] << "x" << size[1] << "x" << size[2]
+             << " over " << num_ranks << " ranks" << endl;
+    }
+
+    vector< float > slab(plane_size * (z_end - z_begin));
+    loader(z_begin, z_end - z_begin, &slab.front(), loader_data);
+
+    buildSlabJoinTree(&slab.front(), size, z_begin, z_end, tree);
+
+    // keep the field around on rank 0 for the single-process comparison
+    vector< float > whole;
+    if (verify)
+    {
+        vector< int > counts(num_ranks), displs(num_ranks);
+        for (int r = 0; r < num_ranks; ++r)
+        {
+            uint zb, ze;
+            ownedPlanes(r, zb, ze);
+            counts[r] = plane_size * (ze - zb);
+            displs[r] = plane_size * zb;
+        }
+        if (rank == 0) whole.resize(plane_size * size[2]);
+        MPI_Gatherv(&slab.front(), slab.size(), MPI_FLOAT,
+                    rank == 0 ? &whole.front() : 0, &counts.front(), &displs.front(), MPI_FLOAT,
+                    0, comm);
+    }
+    vector< float >().swap(slab);
+
+    // binary reduction: at each level the upper neighbour's tree is stitched onto ours
+    JoinTree received, merged;
+    for (int stride = 1; stride < num_ranks; stride *= 2)
+    {
+        if (rank % (2*stride) == stride)
+        {
+            sendJoinTree(tree, rank - stride, comm);
+            break;
+        }
+        if (rank % (2*stride) == 0 && rank + stride < num_ranks)
+        {
+            recvJoinTree(received, rank + stride, comm);
+            stitchJoinTrees(tree, received, merged);
+            tree = merged;
+        }
+    }
+
+    if (rank != 0) return false;
+
+    cout << "MPIJoinTree::build() --> " << tree.countMinima() << " minima, "
+         << tree.countSaddles() << " saddles" << endl;
+
+    if (verify)
+    {
+        JoinTree serial;
+        buildSlabJoinTree(&whole.front(), size, 0, size[2], serial);
+        if (sameJoinTree(tree, serial))
+            cout << "MPIJoinTree::build() --> matches the single-process tree" << endl;
+        else
+            cerr << "PROBLEM!!! MPI join tree differs from the single-process tree" << endl;
+    }
+    return true;
+}
+
+#endif  // USE_MPI
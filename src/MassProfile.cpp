@@ -0,0 +1,99 @@
+/*
+ *  Threshold-sweep mass profiles of a core
+ *
+ *  Source Outline:
+ *      - thresholdProfile
+ *      - writeProfile
+ */
+
+#include "MassProfile.hpp"
+
+#include <algorithm>    // std::upper_bound
+
+using std::vector;
+using std::endl;
+
+void thresholdProfile(const CellEnergetics & e, const vector< VertexId > & sorted,
+                      const unsigned int num_levels, vector< ProfileRow > & rows)
+{
+    rows.clear();
+    const size_t n = sorted.size();
+    if (n == 0 || num_levels == 0) return;
+
+    // prefix sums: element k covers the first k cells
+    vector<double> gpot(n), mass(n + 1), px(n + 1), py(n + 1), pz(n + 1);
+    CompensatedSum m, x, y, z;
+    mass[0] = px[0] = py[0] = pz[0] = 0.0;
+    for (size_t k = 0; k < n; ++k)
+    {
+        const VertexId i = sorted[k];
+        const double cell_mass = e.mass(i);
+        gpot[k] = e.gpot(i);
+        m.add(cell_mass);
+        x.add(cell_mass * e.velx(i));
+        y.add(cell_mass * e.vely(i));
+        z.add(cell_mass * e.velz(i));
+        mass[k + 1] = m.value();
+        px[k + 1] = x.value();
+        py[k + 1] = y.value();
+        pz[k + 1] = z.value();
+    }
+
+    rows.resize(num_levels);
+    for (unsigned int l = 0; l < num_levels; ++l)
+    {
+        ProfileRow & row = rows[l];
+        row.gpot_level = l + 1 == num_levels ? gpot[n - 1]
+                       : gpot[0] + (gpot[n - 1] - gpot[0]) * (l + 1) / num_levels;
+        const size_t k = std::upper_bound(gpot.begin(), gpot.end(), row.gpot_level) - gpot.begin();
+        row.cells = k;
+        row.volume = k * e.cell_vol;
+        row.mass = mass[k];
+        row.px = px[k];
+        row.py = py[k];
+        row.pz = pz[k];
+    }
+
+    // bound mass of every level's region, each against its own CoM and max gpot
+    #pragma omp parallel for schedule(dynamic)
+    for (long l = 0; l < long(num_levels); ++l)
+    {
+        ProfileRow & row = rows[l];
+        row.bound_cells = 0;
+        row.bound_mass = 0.0;
+        if (row.cells == 0) continue;
+
+        BoundMass region;
+        region.com_vel[0] = row.px / row.mass;
+        region.com_vel[1] = row.py / row.mass;
+        region.com_vel[2] = row.pz / row.mass;
+        region.reference_gpot = gpot[row.cells - 1];
+
+        CompensatedSum bound;
+        for (size_t k = 0; k < row.cells; ++k)
+        {
+            double Ekin, Etherm, Egrav;
+            e.energies(sorted[k], region, Ekin, Etherm, Egrav);
+            if (Ekin + Etherm + Egrav < 0.0)
+            {
+                bound.add(e.mass(sorted[k]));
+                ++row.bound_cells;
+            }
+        }
+        row.bound_mass = bound.value();
+    }
+}
+
+void writeProfile(const vector< ProfileRow > & rows, std::ostream & out)
+{
+    out << "# gpot_level cells volume(cm^3) mass(Msol) CoM_velx CoM_vely CoM_velz"
+        << " bound_cells bound_mass(Msol)" << endl;
+    vector< ProfileRow >::const_iterator it;
+    for (it = rows.begin(); it != rows.end(); ++it)
+    {
+        const double mass = it->mass > 0.0 ? it->mass : 1.0;
+        out << it->gpot_level << " " << it->cells << " " << it->volume << " " << it->mass / 2.0e33 << " "
+            << it->px / mass << " " << it->py / mass << " " << it->pz / mass << " "
+            << it->bound_cells << " " << it->bound_mass / 2.0e33 << endl;
+    }
+}
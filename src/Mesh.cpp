@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <algorithm>
+#include <stdint.h>
 
 using std::cout;
 using std::endl;
@@ -12,114 +13,70 @@ using std::sort;
 
 
 //functor for sorting
+template <typename T, typename L>
 class AscendingOrder 
 {
-	Data & data;
+	Data<T, L> & data;
 	public:
-	AscendingOrder( Data & d ) : data(d) {}
-	bool operator()(const uint & a, const uint & b) const { 
+	AscendingOrder( Data<T, L> & d ) : data(d) {}
+	bool operator()(const VertexId & a, const VertexId & b) const { 
 		return data.less( a , b );
 	}
 };
 
 
-void Mesh::createGraph(std::vector<size_t> & order) 
+template <typename T, typename L>
+void Mesh<T, L>::createGraph(std::vector<VertexId> & order) 
 {
 	order.resize( data.totalSize );
 	
-	for (uint i = 0; i < order.size(); i++) 
+	for (VertexId i = 0; i < order.size(); i++) 
 		order[i] = i;
 	
-	sort( order.begin() , order.end(), AscendingOrder(data) );
+	sort( order.begin() , order.end(), AscendingOrder<T, L>(data) );
 }
 
-void Mesh::getNeighbors(size_t i, std::vector<size_t>& n) 
+//odd cells get the 6 face neighbours, even ones the 18 face and edge neighbours, so
+//the grid is split into tetrahedra (CONN_TET); getNeighbors18/26 are the uniform stencils
+template <typename T, typename L>
+void Mesh<T, L>::getNeighbors(VertexId i, std::vector<VertexId>& n) 
 {
-	uint x,y,z;
-	data.convertIndex( i, x, y, z );
-	if ( (x+y+z)%2 == ODD_TET_PARITY ) {
-		find6Neighbors(x,y,z,n);
-	} else {
-		find18Neighbors(x,y,z,n);   // I think it should always use this one?
-	}
+	VectorFill fill = { n };
+	visitNeighbors<CONN_TET>( i, fill );
 }
 
-void Mesh::getNeighbors18(size_t i, std::vector<size_t>& n) 
+template <typename T, typename L>
+void Mesh<T, L>::getNeighbors18(VertexId i, std::vector<VertexId>& n) 
 {
-	uint x,y,z;
-	data.convertIndex( i, x, y, z );
-	find18Neighbors(x,y,z,n);   // I think it should always use this one?
+	VectorFill fill = { n };
+	visitNeighbors<CONN_18>( i, fill );
 }
 
+template <typename T, typename L>
+void Mesh<T, L>::getNeighbors26(VertexId i, std::vector<VertexId>& n) 
+{
+	VectorFill fill = { n };
+	visitNeighbors<CONN_26>( i, fill );
+}
 
-
-void Mesh::find6Neighbors( uint x, uint y, uint z, std::vector< size_t > & neighbors) 
+template <typename T, typename L>
+void Mesh<T, L>::find6Neighbors( uint x, uint y, uint z, std::vector< VertexId > & neighbors) 
 {
-	uint nx[6],ny[6],nz[6];
-	
-	for (uint i = 0; i < 6; i++) {
-		nx[i] = x;
-		ny[i] = y;
-		nz[i] = z;
-	}
-	
-	//first 6 neighbors
-	nx[0] -= 1;
-	ny[1] -= 1;
-	nz[2] -= 1;
-	nx[3] += 1;
-	ny[4] += 1;
-	nz[5] += 1;
-	
-	for (uint i = 0; i < 6; i++) {
-		if (nx[i] >= data.size[0]) continue;	
-		if (ny[i] >= data.size[1]) continue;	
-		if (nz[i] >= data.size[2]) continue;	
-	
-		neighbors.push_back( data.convertIndex(nx[i],ny[i],nz[i]) );
-	}
+	VectorFill fill = { neighbors };
+	StencilLoop<0, 6>::visit<L>( x, y, z, data.size, fill );
 }
 
-void Mesh::find18Neighbors( uint x, uint y, uint z, std::vector< size_t > & neighbors) 
+template <typename T, typename L>
+void Mesh<T, L>::find18Neighbors( uint x, uint y, uint z, std::vector< VertexId > & neighbors) 
 {
-	uint nx[18],ny[18],nz[18];
-	
-	for (uint i = 0; i < 18; i++) {
-		nx[i] = x;
-		ny[i] = y;
-		nz[i] = z;
-	}
-	
-	//first 6 neighbors
-	nx[0] -= 1;   // x-1, y, z
-	ny[1] -= 1;   // x, y-1, z
-	nz[2] -= 1;
-	nx[3] += 1;
-	ny[4] += 1;
-	nz[5] += 1;
-	
-	//the rest of the 18
-	nx[6] -= 1; ny[6]  -= 1;
-	nx[7] += 1; ny[7]  -= 1;
-	ny[8] -= 1; nz[8]  -= 1;
-	ny[9] += 1; nz[9]  -= 1;
-	nz[10]-= 1; nx[10] -= 1;
-	nz[11]+= 1; nx[11] -= 1;
-		
-	nx[12] -= 1; ny[12] += 1;
-	nx[13] += 1; ny[13] += 1;
-	ny[14] -= 1; nz[14] += 1;
-	ny[15] += 1; nz[15] += 1;
-	nz[16] -= 1; nx[16] += 1;
-	nz[17] += 1; nx[17] += 1;
-	
-	for (uint i = 0; i < 18; i++) {
-		
-		
-		if (nx[i] >= data.size[0]) continue;	
-		if (ny[i] >= data.size[1]) continue;	
-		if (nz[i] >= data.size[2]) continue;	
-	
-		neighbors.push_back( data.convertIndex(nx[i],ny[i],nz[i]) );
-	}
+	VectorFill fill = { neighbors };
+	StencilLoop<0, 18>::visit<L>( x, y, z, data.size, fill );
 }
+
+// the value types and layouts used in this code
+template class Mesh<float>;
+template class Mesh<double>;
+template class Mesh<uint16_t>;   // quantized sort keys
+template class Mesh<uint32_t>;
+template class Mesh<float, Brick>;
+template class Mesh<float, Morton>;
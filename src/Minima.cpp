@@ -0,0 +1,155 @@
+/*
+ *  Local minima and basin hierarchy
+ *
+ *  Source Outline:
+ *      - Local funcs
+ *      - findLocalMinima
+ *      - computeBasins
+ */
+
+#include "Minima.hpp"
+
+#include <iostream>
+#include <algorithm>    // std::find
+#include <assert.h>
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+// LOCAL functions
+
+// Data::less() on row-major ids, for values held in a padded field
+template <typename T>
+bool lessThan(const PaddedField<T> & field, const VertexId a, const VertexId b)
+{
+    const T va = field.at(a), vb = field.at(b);
+    if (compareEqual(va, vb)) return a < b;
+    return compareLess(va, vb);
+}
+
+
+/*
+ *      findLocalMinima
+ */
+
+template <typename T>
+void findLocalMinima(const PaddedField<T> & field, vector< VertexId > & minima)
+{
+    const uint nx = field.size[0];
+    const uint ny = field.size[1];
+    const uint nz = field.size[2];
+    const long sy = field.stride_y;
+    const long sz = field.stride_z;
+
+    minima.clear();
+    vector< unsigned char > flag(nx, 0);
+
+    for (uint z = 0; z < nz; z++) {
+        for (uint y = 0; y < ny; y++) {
+            // a neighbour at a lower index wins ties (see Data::less), so it must be
+            // strictly greater; one at a higher index only has to be greater or equal.
+            // Ghosts hold +inf, so cells on the faces need no special case.
+            const T * c = &field.values[field.pad(0, y, z)];
+            for (long x = 0; x < long(nx); x++) {
+                const T v = c[x];
+                const bool face = (c[x-sz] > v) & (c[x-sy] > v) & (c[x-1] > v)
+                                & (c[x+1] >= v) & (c[x+sy] >= v) & (c[x+sz] >= v);
+                const bool edge = (c[x-sz-sy] > v) & (c[x-sz-1] > v) & (c[x-sz+1] > v)
+                                & (c[x-sz+sy] > v) & (c[x-sy-1] > v) & (c[x-sy+1] > v)
+                                & (c[x+sy-1] >= v) & (c[x+sy+1] >= v) & (c[x+sz-sy] >= v)
+                                & (c[x+sz-1] >= v) & (c[x+sz+1] >= v) & (c[x+sz+sy] >= v);
+                const bool odd = ((x + y + z) % 2 == ODD_TET_PARITY);
+                flag[x] = face & (odd | edge);
+            }
+
+            const VertexId row = (VertexId(z) * ny + y) * nx;
+            for (uint x = 0; x < nx; x++)
+                if (flag[x]) minima.push_back(row + x);
+        }
+    }
+    cout << "findLocalMinima() --> " << minima.size() << " local minima" << endl;
+}
+
+
+/*
+ *      computeBasins
+ */
+
+template <typename T>
+void computeBasins(const PaddedField<T> & field, const vector< VertexId > & order,
+                   const vector< VertexId > & minima, Basins & basins)
+{
+    const VertexId size01 = VertexId(field.size[0]) * field.size[1];
+    const VertexId total_size = size01 * field.size[2];
+    const VertexId num_minima = minima.size();
+    basins.minimum = minima;
+    basins.merged_into.assign(num_minima, NOTHING);
+    basins.saddle.assign(num_minima, field.maxValue);
+    basins.persistence.assign(num_minima, double(field.maxValue) - field.minValue);
+
+    basins.label.assign(total_size, NOTHING);
+    for (VertexId id = 0; id < num_minima; id++)
+        basins.label[minima[id]] = id;
+
+    // union-find over padded indices: ghosts are never swept, so they never join anything
+    vector< VertexId > uf(field.values.size(), NOTHING);    // NOTHING until swept
+    vector< VertexId > elder(field.values.size(), NOTHING); // deepest minimum of each component (at roots)
+    vector< VertexId > roots;
+
+    vector< VertexId >::const_iterator it;
+    for (it = order.begin(); it != order.end(); ++it)
+    {
+        const VertexId v = *it;
+        const uint z = v / size01;
+        const uint y = (v - z*size01) / field.size[0];
+        const uint x = v - z*size01 - y*field.size[0];
+        const VertexId p = field.pad(x, y, z);
+        const uint num_nbrs = ((x + y + z) % 2 == ODD_TET_PARITY) ? 6 : 18;
+
+        roots.clear();
+        for (uint i = 0; i < num_nbrs; i++) {
+            VertexId r = p + (i < 6 ? field.face[i] : field.edge[i-6]);
+            if (uf[r] == NOTHING) continue;
+            while (uf[r] != r) {
+                uf[r] = uf[uf[r]];  // path halving
+                r = uf[r];
+            }
+            if (std::find(roots.begin(), roots.end(), r) == roots.end())
+                roots.push_back(r);
+        }
+
+        uf[p] = p;
+        if (roots.empty()) {
+            assert( basins.label[v] != NOTHING );   // the stencil pass missed a minimum
+            elder[p] = basins.label[v];
+            continue;
+        }
+
+        // the oldest (deepest) basin survives, the others die at v
+        VertexId oldest = elder[roots[0]];
+        for (uint i = 1; i < roots.size(); i++)
+            if (lessThan(field, basins.minimum[elder[roots[i]]], basins.minimum[oldest]))
+                oldest = elder[roots[i]];
+
+        for (uint i = 0; i < roots.size(); i++) {
+            const VertexId id = elder[roots[i]];
+            if (id != oldest) {
+                basins.merged_into[id] = oldest;
+                basins.saddle[id] = field.values[p];
+                basins.persistence[id] = double(field.values[p]) - field.at(basins.minimum[id]);
+            }
+            uf[roots[i]] = p;
+        }
+        elder[p] = oldest;
+        basins.label[v] = oldest;
+    }
+}
+
+// the value types used in this code
+template void findLocalMinima(const PaddedField<float> &, vector< VertexId > &);
+template void findLocalMinima(const PaddedField<double> &, vector< VertexId > &);
+template void computeBasins(const PaddedField<float> &, const vector< VertexId > &,
+                            const vector< VertexId > &, Basins &);
+template void computeBasins(const PaddedField<double> &, const vector< VertexId > &,
+                            const vector< VertexId > &, Basins &);
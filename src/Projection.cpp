@@ -0,0 +1,183 @@
+/*
+ *  Column density and mass-weighted projection maps of a box, along x, y and z at once
+ *
+ *  Source Outline:
+ *      - Local types
+ *      - projectBox
+ *      - writeProjections
+ */
+
+#include "Projection.hpp"
+#include "RossGlobals.h"    // HDFIO, HDFDataType
+
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using std::vector;
+
+// LOCAL types
+
+// per map pixel: sum d, sum d v, sum d v^2, sum d over masked cells, any masked cell
+struct ProjectionSums
+{
+    vector< double > s, sv, sv2, sm;
+    vector< unsigned char > any;
+
+    void resize(const size_t n)
+    {
+        s.assign(n, 0.0);
+        sv.assign(n, 0.0);
+        sv2.assign(n, 0.0);
+        sm.assign(n, 0.0);
+        any.assign(n, 0);
+    }
+
+    void add(const size_t k, const double d, const double v, const bool masked)
+    {
+        s[k] += d;
+        sv[k] += d * v;
+        sv2[k] += d * v * v;
+        sm[k] += masked ? d : 0.0;
+        any[k] |= masked;
+    }
+
+    void merge(const ProjectionSums & other)
+    {
+        for (size_t k = 0; k < s.size(); ++k)
+        {
+            s[k] += other.s[k];
+            sv[k] += other.sv[k];
+            sv2[k] += other.sv2[k];
+            sm[k] += other.sm[k];
+            any[k] |= other.any[k];
+        }
+    }
+
+    void finish(const double cell_size, ProjectionMap & map) const
+    {
+        const size_t n = s.size();
+        map.column.resize(n);
+        map.v_los.resize(n);
+        map.sigma_los.resize(n);
+        map.mask_fraction.resize(n);
+        map.mask.assign(any.begin(), any.end());
+        for (size_t k = 0; k < n; ++k)
+        {
+            const double v = s[k] > 0.0 ? sv[k] / s[k] : 0.0;
+            const double var = s[k] > 0.0 ? sv2[k] / s[k] - v * v : 0.0;
+            map.column[k] = s[k] * cell_size;
+            map.v_los[k] = v;
+            map.sigma_los[k] = var > 0.0 ? sqrt(var) : 0.0;
+            map.mask_fraction[k] = s[k] > 0.0 ? sm[k] / s[k] : 0.0;
+        }
+    }
+};
+
+
+/*
+ *      projectBox
+ */
+
+void projectBox(const VolumeView<float> & box, const float * dens, const float * const vel[3],
+                const LabelVolume<2> * mask, const double cell_size, ProjectionMap maps[3])
+{
+    const uint ex = box.extent[0], ey = box.extent[1], ez = box.extent[2];
+    maps[0].dims[0] = ey;  maps[0].dims[1] = ez;
+    maps[1].dims[0] = ex;  maps[1].dims[1] = ez;
+    maps[2].dims[0] = ex;  maps[2].dims[1] = ey;
+
+    ProjectionSums along_x, along_y;
+    along_x.resize(maps[0].size());
+    along_y.resize(maps[1].size());
+
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    vector< ProjectionSums > along_z(num_threads);
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int thread = 0;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+#endif
+        ProjectionSums & z_sums = along_z[thread];
+        z_sums.resize(maps[2].size());
+
+        #pragma omp for schedule(static)
+        for (long z = 0; z < long(ez); ++z)
+        {
+            for (uint y = 0; y < ey; ++y)
+            {
+                const size_t row = box.index(0, y, z);
+                const size_t y_row = size_t(z) * ex;
+                const size_t z_row = size_t(y) * ex;
+                double s = 0.0, sv = 0.0, sv2 = 0.0, sm = 0.0;
+                bool any = false;
+                for (uint x = 0; x < ex; ++x)
+                {
+                    const size_t i = row + x * box.stride[0];
+                    const double d = dens[i];
+                    const bool masked = mask != NULL && mask->get(i) != 0;
+
+                    const double vx = vel[0][i];
+                    s += d;
+                    sv += d * vx;
+                    sv2 += d * vx * vx;
+                    sm += masked ? d : 0.0;
+                    any |= masked;
+
+                    along_y.add(y_row + x, d, vel[1][i], masked);
+                    z_sums.add(z_row + x, d, vel[2][i], masked);
+                }
+                const size_t k = size_t(z) * ey + y;
+                along_x.s[k] = s;
+                along_x.sv[k] = sv;
+                along_x.sv2[k] = sv2;
+                along_x.sm[k] = sm;
+                along_x.any[k] = any;
+            }
+        }
+    }
+
+    // threads in order, so a run is reproducible for a given number of threads
+    for (int t = 1; t < num_threads; ++t) along_z[0].merge(along_z[t]);
+
+    along_x.finish(cell_size, maps[0]);
+    along_y.finish(cell_size, maps[1]);
+    along_z[0].finish(cell_size, maps[2]);
+}
+
+
+/*
+ *      writeProjections
+ */
+
+void writeProjections(HDFIO & file, const std::string prefix, const ProjectionMap maps[3])
+{
+    if (!HDFDataType_is_set)
+    {
+        CheckMachineForLittleBigEndianNumerics();
+    }
+    const int deflate_level = 6;
+    const char axis_name[3] = { 'x', 'y', 'z' };
+    for (int a = 0; a < 3; ++a)
+    {
+        const ProjectionMap & m = maps[a];
+        if (m.size() == 0) continue;
+
+        std::vector<int> dims;     // slowest varying first
+        dims.push_back(m.dims[1]);
+        dims.push_back(m.dims[0]);
+        const std::string name = prefix + "_" + axis_name[a] + "_";
+        file.writeCompressed(&m.column[0], name + "column_density", dims, ::HDFDataType, deflate_level);
+        file.writeCompressed(&m.v_los[0], name + "v_los", dims, ::HDFDataType, deflate_level);
+        file.writeCompressed(&m.sigma_los[0], name + "sigma_los", dims, ::HDFDataType, deflate_level);
+        file.writeCompressed(&m.mask_fraction[0], name + "core_mass_fraction", dims, ::HDFDataType,
+                             deflate_level);
+        file.writeCompressed(&m.mask[0], name + "core_mask", dims, H5T_NATIVE_UCHAR, deflate_level);
+    }
+}
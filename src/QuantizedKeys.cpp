@@ -0,0 +1,102 @@
+/*
+ *  Integer sort keys and radix sort
+ *
+ *  Source Outline:
+ *      - Key construction
+ *      - Radix sort
+ *      - Tie check
+ */
+
+#include "QuantizedKeys.hpp"
+
+#include <iostream>
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+
+/*
+ *      KEY CONSTRUCTION
+ */
+
+void makeFloatKeys(const float * values, const size_t n, vector< uint32_t > & keys)
+{
+    keys.resize(n);
+    for (size_t i = 0; i < n; ++i)
+        keys[i] = floatKey(values[i]);
+}
+
+void makeLinearKeys(const float * values, const size_t n, vector< uint16_t > & keys)
+{
+    keys.resize(n);
+    if (n == 0) return;
+
+    float min = values[0], max = values[0];
+    for (size_t i = 0; i < n; ++i) {
+        if (values[i] < min) min = values[i];
+        if (values[i] > max) max = values[i];
+    }
+
+    // monotone (non-decreasing) in the value, so quantization can only add ties
+    const double scale = (max > min) ? 65535.0 / (double(max) - min) : 0.0;
+    for (size_t i = 0; i < n; ++i)
+        keys[i] = uint16_t((double(values[i]) - min) * scale);
+}
+
+
+/*
+ *      RADIX SORT
+ */
+
+template <typename K>
+void radixSortOrder(const vector< K > & keys, vector< VertexId > & order)
+{
+    const size_t n = keys.size();
+    order.resize(n);
+    for (VertexId i = 0; i < n; ++i) order[i] = i;
+
+    vector< VertexId > buffer(n);
+    for (unsigned int shift = 0; shift < 8 * sizeof(K); shift += 8)
+    {
+        size_t count[257] = { 0 };
+        for (size_t i = 0; i < n; ++i)
+            count[((keys[i] >> shift) & 0xff) + 1]++;
+
+        // every key has the same byte here --> the pass wouldn't move anything
+        bool trivial = false;
+        for (int b = 1; b <= 256; ++b)
+            if (count[b] == n) trivial = true;
+        if (trivial) continue;
+
+        for (int b = 0; b < 256; ++b)
+            count[b + 1] += count[b];
+        for (size_t i = 0; i < n; ++i) {
+            const VertexId v = order[i];
+            buffer[count[(keys[v] >> shift) & 0xff]++] = v;
+        }
+        order.swap(buffer);
+    }
+}
+
+
+/*
+ *      TIE CHECK
+ */
+
+template <typename K>
+size_t countAddedTies(const float * values, const vector< K > & keys, const vector< VertexId > & order)
+{
+    size_t added = 0;
+    for (size_t i = 1; i < order.size(); ++i) {
+        const VertexId a = order[i-1], b = order[i];
+        if (keys[a] == keys[b] && values[a] != values[b]) added++;
+    }
+    return added;
+}
+
+// the key types used in this code
+template void radixSortOrder(const vector< uint16_t > &, vector< VertexId > &);
+template void radixSortOrder(const vector< uint32_t > &, vector< VertexId > &);
+template size_t countAddedTies(const float *, const vector< uint16_t > &, const vector< VertexId > &);
+template size_t countAddedTies(const float *, const vector< uint32_t > &, const vector< VertexId > &);
@@ -0,0 +1,158 @@
+/*
+ *  Radial profiles around sinks (or any centres), every centre in one sweep
+ *
+ *  Source Outline:
+ *      - radialProfiles
+ *      - writeRadialProfiles
+ */
+
+#include "RadialProfile.hpp"
+
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using std::vector;
+using std::endl;
+
+enum { SUM_CELLS, SUM_MASS, SUM_MVR, SUM_MVR2, SUM_MVT2, NUM_SUMS };
+
+/*
+ *      radialProfiles
+ */
+
+void radialProfiles(const float * dens, const float * const vel[3], const uint size[3],
+                    const double origin[3], const double cell_size,
+                    const vector< RadialCentre > & centres, const double r_min,
+                    const double r_max, const uint num_bins,
+                    vector< vector< RadialBin > > & profiles)
+{
+    const uint num_centres = centres.size();
+    const size_t hist_size = size_t(num_centres) * num_bins * NUM_SUMS;
+    const double cell_vol = cell_size * cell_size * cell_size;
+    const double r_min2 = r_min * r_min;
+    const double r_max2 = r_max * r_max;
+    const double bins_per_log_r2 = 0.5 * num_bins / log(r_max / r_min);
+
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    vector< vector< double > > partial(num_threads);
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int thread = 0;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+#endif
+        vector< double > & hist = partial[thread];
+        hist.assign(hist_size, 0.0);
+
+        #pragma omp for schedule(static)
+        for (long z = 0; z < long(size[2]); ++z)
+        {
+            for (uint c = 0; c < num_centres; ++c)
+            {
+                const RadialCentre & centre = centres[c];
+                const double dz = origin[2] + (z + 0.5) * cell_size - centre.pos[2];
+                if (dz * dz >= r_max2) continue;
+                double * h = &hist[size_t(c) * num_bins * NUM_SUMS];
+
+                for (uint y = 0; y < size[1]; ++y)
+                {
+                    const double dy = origin[1] + (y + 0.5) * cell_size - centre.pos[1];
+                    const double rest = r_max2 - dz * dz - dy * dy;
+                    if (rest <= 0.0) continue;
+
+                    // the run of x cells the sphere covers on this row
+                    const double x_centre = (centre.pos[0] - origin[0]) / cell_size - 0.5;
+                    const double half = sqrt(rest) / cell_size;
+                    const long x_lo = long(ceil(x_centre - half));
+                    const long x_hi = long(floor(x_centre + half));
+                    const long first = x_lo > 0 ? x_lo : 0;
+                    const long last = x_hi < long(size[0]) - 1 ? x_hi : long(size[0]) - 1;
+
+                    const size_t row = (size_t(z) * size[1] + y) * size[0];
+                    for (long x = first; x <= last; ++x)
+                    {
+                        const double dx = origin[0] + (x + 0.5) * cell_size - centre.pos[0];
+                        const double r2 = dx * dx + dy * dy + dz * dz;
+                        if (r2 >= r_max2) continue;
+                        long bin = r2 > r_min2 ? long(bins_per_log_r2 * log(r2 / r_min2)) : 0;
+                        if (bin >= long(num_bins)) bin = num_bins - 1;
+
+                        const size_t i = row + x;
+                        const double m = dens[i] * cell_vol;
+                        const double v[3] = { vel[0][i] - centre.vel[0], vel[1][i] - centre.vel[1],
+                                              vel[2][i] - centre.vel[2] };
+                        const double v2 = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+                        const double vr = r2 > 0.0 ? (v[0] * dx + v[1] * dy + v[2] * dz) / sqrt(r2) : 0.0;
+
+                        double * b = h + bin * NUM_SUMS;
+                        b[SUM_CELLS] += 1.0;
+                        b[SUM_MASS] += m;
+                        b[SUM_MVR] += m * vr;
+                        b[SUM_MVR2] += m * vr * vr;
+                        b[SUM_MVT2] += m * (v2 - vr * vr);
+                    }
+                }
+            }
+        }
+    }
+
+    // threads in order, so a run is reproducible for a given number of threads
+    vector< double > hist(hist_size, 0.0);
+    for (int t = 0; t < num_threads; ++t)
+        for (size_t k = 0; k < hist_size; ++k)
+            hist[k] += partial[t][k];
+
+    const double step = log(r_max / r_min) / num_bins;
+    profiles.assign(num_centres, vector< RadialBin >(num_bins));
+    for (uint c = 0; c < num_centres; ++c)
+    {
+        double enclosed = 0.0;
+        for (uint k = 0; k < num_bins; ++k)
+        {
+            const double * b = &hist[(size_t(c) * num_bins + k) * NUM_SUMS];
+            RadialBin & bin = profiles[c][k];
+            bin.r_inner = k == 0 ? 0.0 : r_min * exp(k * step);
+            bin.r_outer = r_min * exp((k + 1) * step);
+            bin.cells = size_t(b[SUM_CELLS]);
+            bin.mass = b[SUM_MASS];
+            bin.mass_vr = b[SUM_MVR];
+            bin.mass_vr2 = b[SUM_MVR2];
+            bin.mass_vt2 = b[SUM_MVT2];
+            enclosed += bin.mass;
+            bin.enclosed_mass = enclosed;
+        }
+    }
+}
+
+/*
+ *      writeRadialProfiles
+ */
+
+void writeRadialProfiles(const vector< vector< RadialBin > > & profiles, const double cell_vol,
+                         std::ostream & out)
+{
+    out << "# centre r_inner(cm) r_outer(cm) cells mean_dens(g/cm^3) mass(Msol) enclosed_mass(Msol)"
+        << " v_r(cm/s) sigma_r(cm/s) v_t_rms(cm/s)" << endl;
+    for (size_t c = 0; c < profiles.size(); ++c)
+    {
+        for (size_t k = 0; k < profiles[c].size(); ++k)
+        {
+            const RadialBin & b = profiles[c][k];
+            const double vr = b.mass > 0.0 ? b.mass_vr / b.mass : 0.0;
+            const double var_r = b.mass > 0.0 ? b.mass_vr2 / b.mass - vr * vr : 0.0;
+            const double vt2 = b.mass > 0.0 ? b.mass_vt2 / b.mass : 0.0;
+            out << c << " " << b.r_inner << " " << b.r_outer << " " << b.cells << " "
+                << (b.cells > 0 ? b.mass / (b.cells * cell_vol) : 0.0) << " "
+                << b.mass / 2.0e33 << " " << b.enclosed_mass / 2.0e33 << " "
+                << vr << " " << (var_r > 0.0 ? sqrt(var_r) : 0.0) << " "
+                << (vt2 > 0.0 ? sqrt(vt2) : 0.0) << endl;
+        }
+        out << endl;    // blank line between centres, for gnuplot's index
+    }
+}
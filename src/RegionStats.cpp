@@ -0,0 +1,229 @@
+/*
+ *  Per-label reductions over a labelled grid
+ *
+ *  Source Outline:
+ *      - RegionMoments
+ *      - reduceRegions
+ *      - regionStats
+ */
+
+#include "RegionStats.hpp"
+#include "Layout.hpp"     // RowMajor::coords
+
+#include <math.h>
+#include <limits>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using std::vector;
+
+/*
+ *      RegionMoments
+ */
+
+RegionMoments::RegionMoments() :
+    cells(0), mass(0.0), mvv(0.0), meint(0.0), mgpot(0.0),
+    gpot_max(-std::numeric_limits<double>::max())
+{
+    for (int d = 0; d < 3; ++d) mx[d] = p[d] = xp[d] = 0.0;
+    for (int d = 0; d < 6; ++d) mxx[d] = 0.0;
+}
+
+void RegionMoments::merge(const RegionMoments & other)
+{
+    cells += other.cells;
+    mass += other.mass;
+    for (int d = 0; d < 3; ++d)
+    {
+        mx[d] += other.mx[d];
+        p[d] += other.p[d];
+        xp[d] += other.xp[d];
+    }
+    for (int d = 0; d < 6; ++d) mxx[d] += other.mxx[d];
+    mvv += other.mvv;
+    meint += other.meint;
+    mgpot += other.mgpot;
+    if (other.gpot_max > gpot_max) gpot_max = other.gpot_max;
+}
+
+/*
+ *      reduceRegions
+ */
+
+// adds cell i, at x y z (in cells from the grid centre), to r
+static inline void addCell(const CellEnergetics & e, const size_t i, const double x, const double y,
+                           const double z, RegionMoments & r)
+{
+    const double m = e.mass(i);
+    const double pos[3] = { x, y, z };
+    const double vel[3] = { e.velx(i), e.vely(i), e.velz(i) };
+    const double g = e.gpot(i);
+
+    r.cells++;
+    r.mass += m;
+    for (int d = 0; d < 3; ++d)
+    {
+        r.mx[d] += m * pos[d];
+        r.p[d] += m * vel[d];
+    }
+    r.xp[0] += m * (pos[1]*vel[2] - pos[2]*vel[1]);
+    r.xp[1] += m * (pos[2]*vel[0] - pos[0]*vel[2]);
+    r.xp[2] += m * (pos[0]*vel[1] - pos[1]*vel[0]);
+    r.mxx[0] += m * pos[0]*pos[0];
+    r.mxx[1] += m * pos[1]*pos[1];
+    r.mxx[2] += m * pos[2]*pos[2];
+    r.mxx[3] += m * pos[0]*pos[1];
+    r.mxx[4] += m * pos[0]*pos[2];
+    r.mxx[5] += m * pos[1]*pos[2];
+    r.mvv += m * (vel[0]*vel[0] + vel[1]*vel[1] + vel[2]*vel[2]);
+    r.meint += m * e.eint(i);
+    r.mgpot += m * g;
+    if (g > r.gpot_max) r.gpot_max = g;
+}
+
+// too many labels for a set of moments per thread: cells bucketed by label, each label
+// reduced by one thread over its cells in index order
+static void reduceSortedByLabel(const CellEnergetics & e, const uint size[3], const VertexId * labels,
+                                const VertexId num_labels, const double centre[3],
+                                vector< RegionMoments > & moments)
+{
+    const size_t n = size_t(size[0]) * size[1] * size[2];
+    vector< size_t > first(size_t(num_labels) + 1, 0);
+    for (size_t i = 0; i < n; ++i)
+        if (labels[i] < num_labels) first[labels[i] + 1]++;
+    for (VertexId l = 0; l < num_labels; ++l) first[l + 1] += first[l];
+
+    vector< VertexId > cells(first[num_labels]);
+    vector< size_t > filled(first.begin(), first.end() - 1);
+    for (size_t i = 0; i < n; ++i)
+        if (labels[i] < num_labels) cells[filled[labels[i]]++] = i;
+    vector< size_t >().swap(filled);
+
+    moments.assign(num_labels, RegionMoments());
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (long l = 0; l < long(num_labels); ++l)
+    {
+        RegionMoments & r = moments[l];
+        for (size_t k = first[l]; k < first[l + 1]; ++k)
+        {
+            uint x, y, z;
+            RowMajor::coords(cells[k], size, x, y, z);
+            addCell(e, cells[k], x - centre[0], y - centre[1], z - centre[2], r);
+        }
+    }
+}
+
+void reduceRegions(const CellEnergetics & e, const uint size[3], const VertexId * labels,
+                   const VertexId num_labels, vector< RegionMoments > & moments,
+                   const size_t budget)
+{
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    const double centre[3] = { 0.5 * (size[0] - 1.0), 0.5 * (size[1] - 1.0), 0.5 * (size[2] - 1.0) };
+
+    if (double(num_labels) * num_threads * sizeof(RegionMoments) > budget)
+    {
+        reduceSortedByLabel(e, size, labels, num_labels, centre, moments);
+        return;
+    }
+
+    vector< vector< RegionMoments > > partial(num_threads);
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int thread = 0;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+#endif
+        vector< RegionMoments > & acc = partial[thread];
+        acc.resize(num_labels);
+
+        #pragma omp for schedule(static)
+        for (long z = 0; z < long(size[2]); ++z)
+        {
+            for (uint y = 0; y < size[1]; ++y)
+            {
+                const size_t row = (size_t(z) * size[1] + y) * size[0];
+                for (uint x = 0; x < size[0]; ++x)
+                {
+                    const size_t i = row + x;
+                    const VertexId label = labels[i];
+                    if (label >= num_labels) continue;
+                    addCell(e, i, x - centre[0], y - centre[1], z - centre[2], acc[label]);
+                }
+            }
+        }
+    }
+
+    // threads in order, so a run is reproducible for a given number of threads
+    moments.assign(num_labels, RegionMoments());
+    for (int t = 0; t < num_threads; ++t)
+        for (size_t l = 0; l < partial[t].size(); ++l)
+            moments[l].merge(partial[t][l]);
+}
+
+/*
+ *      regionStats
+ */
+
+void regionStats(const RegionMoments & m, const uint size[3], const double cell_size,
+                 const double origin[3], const double cell_vol, RegionStats & stats)
+{
+    stats.cells = m.cells;
+    stats.volume = m.cells * cell_vol;
+    stats.mass = m.mass;
+    stats.gpot_max = m.gpot_max;
+    stats.Etherm = m.meint;
+    if (m.cells == 0 || m.mass <= 0.0)
+    {
+        for (int d = 0; d < 3; ++d) stats.com[d] = stats.com_vel[d] = stats.L[d] = 0.0;
+        for (int d = 0; d < 6; ++d) stats.inertia[d] = 0.0;
+        stats.sigma_v = stats.Ekin = stats.Egrav = 0.0;
+        return;
+    }
+
+    double X[3], V[3];      // CoM in cells from the centre, CoM velocity
+    for (int d = 0; d < 3; ++d)
+    {
+        X[d] = m.mx[d] / m.mass;
+        V[d] = m.p[d] / m.mass;
+        stats.com[d] = origin[d] + (X[d] + 0.5 * size[d]) * cell_size;
+        stats.com_vel[d] = V[d];
+    }
+
+    // about the CoM: subtract the part carried by the CoM itself
+    stats.L[0] = (m.xp[0] - m.mass * (X[1]*V[2] - X[2]*V[1])) * cell_size;
+    stats.L[1] = (m.xp[1] - m.mass * (X[2]*V[0] - X[0]*V[2])) * cell_size;
+    stats.L[2] = (m.xp[2] - m.mass * (X[0]*V[1] - X[1]*V[0])) * cell_size;
+
+    const double V2 = V[0]*V[0] + V[1]*V[1] + V[2]*V[2];
+    stats.Ekin = 0.5 * (m.mvv - m.mass * V2);
+    const double sigma2 = (m.mvv / m.mass - V2) / 3.0;
+    stats.sigma_v = sigma2 > 0.0 ? sqrt(sigma2) : 0.0;
+
+    // central second moments S_ij, then I = tr(S) delta_ij - S_ij
+    const double area = cell_size * cell_size;
+    const double S[6] = { (m.mxx[0] - m.mass * X[0]*X[0]) * area,
+                          (m.mxx[1] - m.mass * X[1]*X[1]) * area,
+                          (m.mxx[2] - m.mass * X[2]*X[2]) * area,
+                          (m.mxx[3] - m.mass * X[0]*X[1]) * area,
+                          (m.mxx[4] - m.mass * X[0]*X[2]) * area,
+                          (m.mxx[5] - m.mass * X[1]*X[2]) * area };
+    const double trace = S[0] + S[1] + S[2];
+    stats.inertia[0] = trace - S[0];
+    stats.inertia[1] = trace - S[1];
+    stats.inertia[2] = trace - S[2];
+    stats.inertia[3] = -S[3];
+    stats.inertia[4] = -S[4];
+    stats.inertia[5] = -S[5];
+
+    stats.Egrav = m.mgpot - m.mass * m.gpot_max;
+}
+
+double RegionStats::virialRatio() const
+{
+    return 2.0 * (Ekin + Etherm) / fabs(Egrav);
+}
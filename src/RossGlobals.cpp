@@ -42,3 +42,68 @@ void loadArrayFromHDF(float* data, std::string filename, std::string dataset_nam
     HDFInput.close();
 }
 
+// hyperslab covering whole planes [z_begin, z_begin+num_z) of an open file
+static void readPlanes(HDFIO & HDFInput, float* data, std::string dataset_name,
+                       const unsigned int z_begin, const unsigned int num_z)
+{
+    std::vector<int> offset = HDFInput.getDims(dataset_name);
+    std::vector<int> count = offset;
+    for (unsigned int i = 0; i < offset.size(); ++i)
+    {
+        offset[i] = 0;
+    }
+    offset[0] = z_begin;
+    count[0] = num_z;
+    HDFInput.readHyperslab(data, dataset_name, offset, count, ::HDFDataType);
+}
+
+/*
+ * Planes [z_begin, z_begin+num_z) of a 3D dataset (stored z-slowest) are loaded into *data
+ */
+void loadSlabFromHDF(float* data, std::string filename, std::string dataset_name,
+                     const unsigned int z_begin, const unsigned int num_z)
+{
+    if (!HDFDataType_is_set)
+    {
+        CheckMachineForLittleBigEndianNumerics();
+    }
+    HDFIO HDFInput = HDFIO();
+    HDFInput.open(filename, 'r');
+    readPlanes(HDFInput, data, dataset_name, z_begin, num_z);
+    HDFInput.close();
+}
+
+#ifdef USE_MPI
+/*
+ * As above, but called collectively by every rank in comm, each for its own planes
+ */
+void loadSlabFromHDF(float* data, std::string filename, std::string dataset_name,
+                     const unsigned int z_begin, const unsigned int num_z, MPI_Comm comm)
+{
+    if (!HDFDataType_is_set)
+    {
+        CheckMachineForLittleBigEndianNumerics();
+    }
+    HDFIO HDFInput = HDFIO();
+#ifdef H5_HAVE_PARALLEL
+    HDFInput.openParallel(filename, comm);
+#else
+    (void) comm;    // serial HDF5: every rank opens the file on its own
+    HDFInput.open(filename, 'r');
+#endif
+    readPlanes(HDFInput, data, dataset_name, z_begin, num_z);
+    HDFInput.close();
+}
+#endif
+
+/*
+ * Returns the dimensions of a dataset without reading it (slowest varying first)
+ */
+std::vector<int> getDimsFromHDF(std::string filename, std::string dataset_name)
+{
+    HDFIO HDFInput = HDFIO();
+    HDFInput.open(filename, 'r');
+    std::vector<int> dims = HDFInput.getDims(dataset_name);
+    HDFInput.close();
+    return dims;
+}
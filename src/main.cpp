@@ -5,8 +5,12 @@
 #include "SinkRecord.hpp"
 #include "CoreAnalyzer.hpp"
 #include "ezOptionParser.hpp"
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
 
 using std::cout;
+using std::cerr;
 using std::endl;
 
 int main(int argc, const char * argv[])
@@ -27,8 +31,327 @@ int main(int argc, const char * argv[])
         "-input_file"
     );
 
+    // flag for building the gpot join tree out-of-core, in slabs fitting the given budget
+    opt.add(
+        "",     // no default --> analyze in-core
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Build the join tree out-of-core, with this memory budget (MB).",   // help info
+        "-ooc",   // allowed option flags
+        "-out_of_core"
+    );
+
+    // flag for the libtourtre core finder, writing the integrals of every arc to a file
+    opt.add(
+        "",     // no default --> seeded region growing
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Find cores with libtourtre and write per-arc integrals (core mass function) here.",
+        "-arcs",
+        "-arc_file"
+    );
+
+    // sort keys for the libtourtre sweep (-arcs)
+    opt.add(
+        "0",    // default --> sort the gpot values themselves
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Sort and sweep 16 or 32 bit integer keys of gpot instead of the values (with -arcs).",
+        "-keys",
+        "-key_bits"
+    );
+
+    // memory layout of the gpot copy swept for -arcs
+    opt.add(
+        "row",  // default --> row-major, gpot is swept in place
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Layout of gpot for the libtourtre sweep (with -arcs): row, brick or morton.",
+        "-layout"
+    );
+
+    // neighbours of each cell in the libtourtre sweep
+    opt.add(
+        "tet",  // default --> 6 neighbours for odd cells, 18 for even ones
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Connectivity for -arcs, -components and -dendrogram: tet, 6, 18 or 26.",
+        "-conn",
+        "-connectivity"
+    );
+
+    // flag for timing the neighbour gathers of each layout
+    opt.add(
+        "",     // no default
+        0,      // not required
+        0,      // no args expected
+        0,      // ... so, no delimiter
+        "Benchmark neighbour-gather throughput of gpot in each memory layout.",
+        "-bench_layout"
+    );
+
+    // memory the grid fields may take up, they are read as the analyses need them
+    opt.add(
+        "0",    // default --> no limit, nothing is evicted
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Memory budget (MB) for the loaded grid fields; least recently used ones are evicted.",
+        "-field_budget"
+    );
+
+    // rounds of dropping unbound cells and recomputing the core's CoM
+    opt.add(
+        "1",    // default --> classify once, against the CoM of the whole core region
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Maximum rounds of iterative unbinding for the bound mass (1: no iteration).",
+        "-unbind"
+    );
+
+    // mass profile of the core against the bounding gpot level
+    opt.add(
+        "",     // no default --> no profile
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Write the core's (bound) mass against the gpot level bounding it to this file.",
+        "-profile"
+    );
+
+    // number of gpot levels in the -profile table
+    opt.add(
+        "64",   // default
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Number of gpot levels for -profile.",
+        "-levels"
+    );
+
+    // sink neighbourhood for a second bound mass, taken straight from the loaded fields
+    opt.add(
+        "",     // no default --> core region only
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Also find the bound mass of the box of cells within this radius (cells) of the sink.",
+        "-box"
+    );
+
+    // flag for cataloguing every persistent gpot minimum, with or without a sink
+    opt.add(
+        "",     // no default --> only the core around sink_id
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Find all persistent gpot minima (sinkless cores too) and write a catalogue here.",
+        "-cores",
+        "-core_catalogue"
+    );
+
+    // persistence threshold for -cores
+    opt.add(
+        "0.0",  // default --> keep every local minimum
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Minimum persistence (erg/g) of a gpot minimum for -cores.",
+        "-p",
+        "-persistence"
+    );
+
+    // -cores on the box around the sink rather than the whole grid
+    opt.add(
+        "0",    // default --> the whole grid
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Half-width (cells) of the box around the sink that -cores searches, 0 for the whole grid.",
+        "-cores_radius"
+    );
+
+    // connected regions of a thresholded field, a quick alternative to the contour tree
+    opt.add(
+        "",     // no default --> no components
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Label the connected regions of -field above -threshold and write a catalogue here.",
+        "-components"
+    );
+
+    // field thresholded for -components
+    opt.add(
+        "dens", // default
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Field for -components: gpot, dens, eint, velx, vely or velz.",
+        "-field"
+    );
+
+    // threshold for -components
+    opt.add(
+        "1.0e-19",  // default
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Threshold for -components (in the field's units).",
+        "-threshold"
+    );
+
+    // flag for components below the threshold instead
+    opt.add(
+        "",     // no default
+        0,      // not required
+        0,      // no args expected
+        0,      // ... so, no delimiter
+        "Components of the cells below -threshold instead of above (e.g. gpot wells).",
+        "-below"
+    );
+
+    // clump hierarchy of dens, for comparing with observers' dendrogram catalogues
+    opt.add(
+        "",     // no default --> no dendrogram
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Write the dens dendrogram to this file (binary branch tree format).",
+        "-dendrogram"
+    );
+
+    // pruning of the -dendrogram
+    opt.add(
+        "1.0e-21",  // default
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Lowest dens (g/cm^3) in the -dendrogram.",
+        "-min_value"
+    );
+
+    opt.add(
+        "1.0e-21",  // default
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Height (g/cm^3) a -dendrogram leaf must rise above where it merges.",
+        "-min_delta"
+    );
+
+    opt.add(
+        "27",   // default --> a 3^3 block
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Cells a -dendrogram leaf must have.",
+        "-min_cells"
+    );
+
+    // radial profiles around every sink, in one pass over the grid
+    opt.add(
+        "",     // no default --> no profiles
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Write log-binned radial profiles around every sink to this file.",
+        "-radial"
+    );
+
+    opt.add(
+        "0.5",  // default --> the innermost bin is the sink's own cell
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Inner radius (cells) of the -radial bins, closer cells go in the first bin.",
+        "-r_min"
+    );
+
+    opt.add(
+        "64",   // default
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Outer radius (cells) of the -radial profiles.",
+        "-r_max"
+    );
+
+    opt.add(
+        "32",   // default
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Number of log-spaced -radial bins.",
+        "-bins"
+    );
+
+    // quick-look maps of every sink's neighbourhood, with the core region overlaid
+    opt.add(
+        "",     // no default --> no maps
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Write x, y and z projections of the box around every sink to this HDF5 file.",
+        "-proj"
+    );
+
+    opt.add(
+        "64",   // default
+        0,      // not required
+        1,      // single arg expected
+        0,      // ... so, no delimiter
+        "Half-width (cells) of the -proj boxes.",
+        "-proj_radius"
+    );
+
+#ifdef USE_MPI
+    // flag for building the gpot join tree over z-slabs, one per rank
+    opt.add(
+        "",     // no default --> the usual single-process analysis
+        0,      // not required
+        0,      // no args expected
+        0,      // ... so, no delimiter
+        "Build the join tree distributed over the MPI ranks, then exit.",
+        "-mpi",
+        "-mpi_tree"
+    );
+
+    // flag for comparing the distributed tree against a single-process build on rank 0
+    opt.add(
+        "",     // no default
+        0,      // not required
+        0,      // no args expected
+        0,      // ... so, no delimiter
+        "Check the -mpi join tree against a single-process build (small grids only).",
+        "-verify"
+    );
+#endif
+
     opt.parse(argc, argv);
 
+    // counts passed on as unsigned, checked before any data is read
+    int unbind_iterations;
+    opt.get("-unbind")->getInt(unbind_iterations);
+    if (unbind_iterations < 1)
+    {
+        cerr << "PROBLEM!!! -unbind must be at least 1, not " << unbind_iterations << endl;
+        return 1;
+    }
+    int num_levels;
+    opt.get("-levels")->getInt(num_levels);
+    if (num_levels < 1)
+    {
+        cerr << "PROBLEM!!! -levels must be at least 1, not " << num_levels << endl;
+        return 1;
+    }
+
     /* set infile to -f argument (or default) */
     opt.get("-f")->getString(infile);
 
@@ -65,10 +388,132 @@ int main(int argc, const char * argv[])
 
     CoreAnalyzer TestAnalyzer(data_dir, TestRecord, 0);
 
-    TestAnalyzer.loadAllData();
-    TestAnalyzer.mapSinkGravity();
-    TestAnalyzer.altFindCoreRegion();   // using seeded region-growing
+#ifdef USE_MPI
+    if (opt.isSet("-mpi"))
+    {
+        MPI_Init(NULL, NULL);
+        TestAnalyzer.findJoinTreeMPI(MPI_COMM_WORLD, opt.isSet("-verify"));
+        MPI_Finalize();
+        return 0;
+    }
+#endif
+
+    if (opt.isSet("-ooc"))
+    {
+        unsigned long budget_mb;
+        opt.get("-ooc")->getULong(budget_mb);
+        TestAnalyzer.findJoinTreeOutOfCore(budget_mb * 1024 * 1024);
+        return 0;
+    }
+
+    unsigned long field_budget_mb;
+    opt.get("-field_budget")->getULong(field_budget_mb);
+    TestAnalyzer.openData(field_budget_mb * 1024 * 1024);
+
+    // stages that only read dens and the velocities, gpot is never loaded for them
+    if (opt.isSet("-dendrogram"))
+    {
+        std::string dendrogram_file, connectivity;
+        float min_value, min_delta;
+        unsigned long min_cells;
+        opt.get("-dendrogram")->getString(dendrogram_file);
+        opt.get("-min_value")->getFloat(min_value);
+        opt.get("-min_delta")->getFloat(min_delta);
+        opt.get("-min_cells")->getULong(min_cells);
+        opt.get("-conn")->getString(connectivity);
+        TestAnalyzer.setConnectivity(connectivity);
+        TestAnalyzer.writeDendrogram(min_value, min_delta, min_cells, dendrogram_file);
+        return 0;
+    }
+
+    if (opt.isSet("-radial"))
+    {
+        std::string radial_file;
+        double r_min, r_max;
+        int num_bins;
+        opt.get("-radial")->getString(radial_file);
+        opt.get("-r_min")->getDouble(r_min);
+        opt.get("-r_max")->getDouble(r_max);
+        opt.get("-bins")->getInt(num_bins);
+        TestAnalyzer.writeSinkProfiles(r_min, r_max, num_bins, radial_file);
+        return 0;
+    }
+
+    TestAnalyzer.mapSinkGravity();   // gpot gets the sink potentials as it is loaded
+    if (opt.isSet("-bench_layout"))
+    {
+        TestAnalyzer.benchmarkLayouts();
+        return 0;
+    }
+
+    if (opt.isSet("-cores"))
+    {
+        std::string catalogue_file;
+        float persistence;
+        int radius;
+        opt.get("-cores")->getString(catalogue_file);
+        opt.get("-p")->getFloat(persistence);
+        opt.get("-cores_radius")->getInt(radius);
+        TestAnalyzer.findAllCores(persistence, catalogue_file, radius);
+        return 0;
+    }
+
+    if (opt.isSet("-components"))
+    {
+        std::string catalogue_file, field, connectivity;
+        float threshold;
+        opt.get("-components")->getString(catalogue_file);
+        opt.get("-field")->getString(field);
+        opt.get("-threshold")->getFloat(threshold);
+        opt.get("-conn")->getString(connectivity);
+        TestAnalyzer.setConnectivity(connectivity);
+        TestAnalyzer.findComponents(field, threshold, !opt.isSet("-below"), catalogue_file);
+        return 0;
+    }
+
+    if (opt.isSet("-arcs"))
+    {
+        std::string arc_file;
+        opt.get("-arcs")->getString(arc_file);
+        int key_bits;
+        opt.get("-keys")->getInt(key_bits);
+        TestAnalyzer.setKeyBits(key_bits);
+        std::string layout;
+        opt.get("-layout")->getString(layout);
+        TestAnalyzer.setLayout(layout);
+        std::string connectivity;
+        opt.get("-conn")->getString(connectivity);
+        TestAnalyzer.setConnectivity(connectivity);
+        TestAnalyzer.findCoreRegion();      // integrates every arc during the sweep
+        TestAnalyzer.writeArcIntegrals(arc_file);
+    }
+    else
+    {
+        TestAnalyzer.altFindCoreRegion();   // using seeded region-growing
+    }
+    TestAnalyzer.setUnbindIterations(unbind_iterations);
     cout << "...calculateBoundMass() returned: " << TestAnalyzer.calculateBoundMass() << endl;
+    if (opt.isSet("-profile"))
+    {
+        std::string profile_file;
+        opt.get("-profile")->getString(profile_file);
+        TestAnalyzer.writeThresholdProfile(profile_file, num_levels);
+    }
+    if (opt.isSet("-box"))
+    {
+        int radius;
+        opt.get("-box")->getInt(radius);
+        cout << "...calculateBoundMassInBox() returned: "
+             << TestAnalyzer.calculateBoundMassInBox(radius) << endl;
+    }
+    if (opt.isSet("-proj"))
+    {
+        std::string proj_file;
+        int radius;
+        opt.get("-proj")->getString(proj_file);
+        opt.get("-proj_radius")->getInt(radius);
+        TestAnalyzer.writeSinkProjections(radius, proj_file);
+    }
 
     return 0;
 }